@@ -0,0 +1,216 @@
+#include "AssetBundle.hpp"
+#include <cstring>
+#include <fstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+static const char Magic[4] = {'K', 'R', 'A', 'B'};
+
+static string HashName(const char* path)
+{
+    return string(path) + ".hash";
+}
+
+/// FNV-1a of the file's contents. Returns false if it can't be read.
+static bool HashFile(const char* path, uint64_t& hash)
+{
+    ifstream stream(path, ifstream::binary);
+    if (!stream) return false;
+
+    hash = 14695981039346656037ull;
+    char buffer[4096];
+
+    while (stream.read(buffer, sizeof(buffer)) || stream.gcount())
+    {
+        for (streamsize i = 0; i < stream.gcount(); ++i)
+        {
+            hash ^= uint8_t(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+    }
+
+    return stream.eof();
+}
+
+AssetBundle::~AssetBundle()
+{
+    Close();
+}
+
+bool AssetBundle::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    ifstream stream(path, ifstream::binary | ifstream::ate);
+    if (!stream) return false;
+
+    _fallback.resize(size_t(stream.tellg()));
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(_fallback.data()), _fallback.size());
+    if (!stream) return false;
+
+    _data = _fallback.data();
+    _size = _fallback.size();
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    void* mapping = MAP_FAILED;
+    if (!fstat(fd, &info) && info.st_size > 0)
+    {
+        mapping = mmap(
+            nullptr,
+            size_t(info.st_size),
+            PROT_READ,
+            MAP_PRIVATE,
+            fd,
+            0);
+    }
+
+    close(fd);
+    if (mapping == MAP_FAILED) return false;
+
+    _data = static_cast<const uint8_t*>(mapping);
+    _size = size_t(info.st_size);
+#endif
+
+    BundleHeader header;
+    bool isValid = _size >= sizeof(header);
+
+    if (isValid)
+    {
+        memcpy(&header, _data, sizeof(header));
+        isValid = !memcmp(header.magic, Magic, sizeof(Magic)) &&
+            header.version == BundleVersion &&
+            header.entryCount <=
+                (_size - sizeof(header)) / sizeof(BundleEntry);
+    }
+
+    if (!isValid) Close();
+    return isValid;
+}
+
+void AssetBundle::Close()
+{
+#ifndef _WIN32
+    if (_data) munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+    _fallback.clear();
+    _data = nullptr;
+    _size = 0;
+}
+
+Span<const uint8_t> AssetBundle::Find(const char* name) const
+{
+    if (!_data) return {nullptr, 0};
+
+    BundleHeader header;
+    memcpy(&header, _data, sizeof(header));
+    auto entries = _data + sizeof(header);
+
+    for (uint32_t i = 0; i < header.entryCount; ++i)
+    {
+        BundleEntry entry;
+        memcpy(&entry, entries + i * sizeof(entry), sizeof(entry));
+
+        if (!strncmp(entry.name, name, sizeof(entry.name)) &&
+            entry.offset <= _size &&
+            entry.size <= _size - entry.offset)
+        {
+            return {_data + entry.offset, int(entry.size)};
+        }
+    }
+
+    return {nullptr, 0};
+}
+
+bool AssetBundle::IsStale(const char* path) const
+{
+    uint64_t hash;
+    if (!HashFile(path, hash)) return false;
+
+    uint64_t bakedHash;
+    auto blob = Find(HashName(path).c_str());
+    if (blob.count != sizeof(bakedHash)) return true;
+
+    memcpy(&bakedHash, blob.data, sizeof(bakedHash));
+    return hash != bakedHash;
+}
+
+void AssetBundleWriter::Add(const char* name, const void* data, size_t size)
+{
+    auto bytes = static_cast<const uint8_t*>(data);
+    _entries.emplace_back(name, vector<uint8_t>(bytes, bytes + size));
+}
+
+bool AssetBundleWriter::AddSourceHash(const char* path)
+{
+    uint64_t hash;
+    if (!HashFile(path, hash)) return false;
+
+    Add(HashName(path).c_str(), &hash, sizeof(hash));
+    return true;
+}
+
+bool AssetBundleWriter::Save(const char* path) const
+{
+    auto align = [](uint64_t n)
+    {
+        return (n + BundleAlignment - 1) / BundleAlignment * BundleAlignment;
+    };
+
+    BundleHeader header = {};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = BundleVersion;
+    header.entryCount = uint32_t(_entries.size());
+
+    vector<BundleEntry> entries(_entries.size());
+    uint64_t offset =
+        align(sizeof(header) + sizeof(BundleEntry) * entries.size());
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto& name = _entries[i].first;
+        if (name.size() >= sizeof(entries[i].name)) return false;
+
+        memset(entries[i].name, 0, sizeof(entries[i].name));
+        memcpy(entries[i].name, name.data(), name.size());
+        entries[i].offset = offset;
+        entries[i].size = _entries[i].second.size();
+        offset = align(offset + entries[i].size);
+    }
+
+    ofstream stream(path, ofstream::binary);
+    if (!stream) return false;
+
+    uint64_t written = 0;
+    auto write = [&](const void* data, size_t size)
+    {
+        stream.write(static_cast<const char*>(data), size);
+        written += size;
+    };
+
+    auto pad = [&]()
+    {
+        static const char Zeros[BundleAlignment] = {};
+        write(Zeros, align(written) - written);
+    };
+
+    write(&header, sizeof(header));
+    write(entries.data(), sizeof(BundleEntry) * entries.size());
+
+    for (const auto& entry : _entries)
+    {
+        pad();
+        write(entry.second.data(), entry.second.size());
+    }
+
+    return bool(stream);
+}
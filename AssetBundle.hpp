@@ -0,0 +1,97 @@
+#ifndef AssetBundle_hpp
+#define AssetBundle_hpp
+
+#include "Span.hpp"
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/// A bundle is one file of named blobs: a BundleHeader, entryCount
+/// BundleEntry records, then the blobs, each aligned to BundleAlignment.
+/// Integers are native endian; bake the bundle on the target platform.
+///
+/// Each source file the blobs were baked from also gets a "<path>.hash"
+/// blob, a uint64_t FNV-1a of its contents, so a bundle that is older
+/// than its sources can be spotted and skipped.
+constexpr uint32_t BundleVersion = 4;
+constexpr size_t BundleAlignment = 64;
+constexpr const char* BundlePath = "assets.bundle";
+
+struct BundleHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct BundleEntry
+{
+    char name[48];
+    uint64_t offset;
+    uint64_t size;
+};
+
+/// Precedes the pixels of an image blob. Pixels are ABGR8888.
+struct BundleImageHeader
+{
+    int32_t width;
+    int32_t height;
+};
+
+/// Contents of the "atlas.info" blob. Mip levels are stored as
+/// "atlas.level.0" and up; the region table as "atlas.regions", the
+/// per-ID opacity and animation bytes as "atlas.opaque" and
+/// "atlas.animation", and the AtlasAnimation table as "atlas.animations".
+struct BundleAtlasInfo
+{
+    int32_t levelCount;
+    int32_t maxCleanLevel;
+};
+
+/// Read-only view of a bundle. The file is memory mapped, so blobs can be
+/// handed to GL without copying them first.
+class AssetBundle
+{
+    const uint8_t* _data = nullptr;
+    size_t _size = 0;
+    std::vector<uint8_t> _fallback;
+
+public:
+    AssetBundle() = default;
+    AssetBundle(AssetBundle&&) = delete;
+    AssetBundle(const AssetBundle&) = delete;
+    ~AssetBundle();
+
+    AssetBundle& operator=(AssetBundle&&) = delete;
+    AssetBundle& operator=(const AssetBundle&) = delete;
+
+    /// Returns false if the file is missing or not a valid bundle.
+    bool Open(const char* path);
+    void Close();
+
+    /// Returns an empty span if there is no such entry.
+    Span<const uint8_t> Find(const char* name) const;
+
+    /// Whether the loose file at path differs from the copy that was
+    /// baked, because it was edited since. False if there is no loose
+    /// file to compare against.
+    bool IsStale(const char* path) const;
+};
+
+class AssetBundleWriter
+{
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> _entries;
+
+public:
+    void Add(const char* name, const void* data, size_t size);
+
+    /// Records the hash of a source file for AssetBundle::IsStale.
+    /// Returns false if the file can't be read.
+    bool AddSourceHash(const char* path);
+
+    bool Save(const char* path) const;
+};
+
+#endif
@@ -0,0 +1,950 @@
+#include "Benchmark.hpp"
+#include "Debug.hpp"
+#include "Lighting.hpp"
+#include "RenderGridBuffer.hpp"
+#include "Pacing.hpp"
+#include "Process.hpp"
+#include "Jobs.hpp"
+#include "Collision.hpp"
+#include "Rational.hpp"
+#include "Intersections.hpp"
+#include "Raycast.hpp"
+#include "Broadphase.hpp"
+#include "PointArray.hpp"
+#include <SDL.h>
+#include <cstring>
+#include <functional>
+using namespace std;
+
+static constexpr double MinimumSeconds = 0.25;
+
+static double Seconds(Uint64 ticks)
+{
+    return double(ticks) / double(SDL_GetPerformanceFrequency());
+}
+
+/// Calls body until MinimumSeconds have passed and returns the mean
+/// seconds per call. Setup, if any, runs before each call untimed.
+template<typename S, typename F> static double TimeEach(S&& setup, F&& body)
+{
+    Uint64 total = 0;
+    int count = 0;
+
+    while (Seconds(total) < MinimumSeconds || count < 3)
+    {
+        setup();
+        auto start = SDL_GetPerformanceCounter();
+        body();
+        total += SDL_GetPerformanceCounter() - start;
+        ++count;
+    }
+
+    return Seconds(total) / count;
+}
+
+template<typename F> static double TimeEach(F&& body)
+{
+    return TimeEach([]{}, body);
+}
+
+static void BenchmarkLighting()
+{
+    mt19937 mt(1);
+    auto grid = GenerateSimple({2048, 512}, mt);
+
+    // Nothing in the sheet glows yet; borrow a grass variant so the glow
+    // channel has work to do.
+    vector<uint8_t> emission(0x20, 0);
+    emission[0x03] = 12;
+
+    LightField light;
+    light.SetEmission(emission);
+
+    auto full = TimeEach([&]{ light.Compute(grid); });
+    Log() << "lighting: full " << grid.size << " world "
+        << (full * 1000.0) << " ms\n";
+
+    // Find the surface of a column to edit around.
+    Point<int> surface = {grid.size.x / 2, grid.size.y - 1};
+    auto span = grid.ToSpan2D();
+    while (surface.y > 0 && span(surface.x, surface.y) == NoTile) --surface.y;
+
+    struct Edit
+    {
+        const char* label;
+        Point<int> position;
+    };
+
+    const Edit edits[] = {
+        {"surface tile", surface},
+        {"buried tile", {surface.x, surface.y / 2}},
+        {"air tile", {surface.x, surface.y + 4}}};
+
+    for (const auto& edit : edits)
+    {
+        auto original = span(edit.position.x, edit.position.y);
+        auto changed = original == NoTile ? uint16_t(0x11) : NoTile;
+        bool toggle = false;
+
+        // Alternate between removing and restoring, so every timed update
+        // is a real change against a settled field.
+        light.Compute(grid);
+        auto each = TimeEach([&]
+        {
+            toggle = !toggle;
+            grid.Set(edit.position, toggle ? changed : original);
+            light.Update(grid, edit.position);
+        });
+
+        if (toggle)
+        {
+            grid.Set(edit.position, original);
+            light.Update(grid, edit.position);
+        }
+
+        Log() << "lighting: single edit of " << edit.label << ' '
+            << (each * 1000000.0) << " us\n";
+    }
+}
+
+static void BenchmarkLayers()
+{
+    mt19937 mt(1);
+    auto grid = GenerateSimple({2048, 512}, mt);
+
+    auto atlas = PackAtlas(
+        SliceSheet(LoadImage("images/sheet.png"), TileSheetCellSize),
+        TileAtlasGutter);
+
+    LightField light;
+    light.Compute(grid);
+
+    // A view-sized window straddling the surface, where all three layers
+    // and open sky are on screen together.
+    Point<int> size = {64, 48};
+    Point<int> start = {grid.size.x / 2, grid.size.y / 2 - size.y / 2};
+
+    RenderGridBuffer buffer;
+    auto each = TimeEach([&]
+    {
+        ++grid.revision; // Defeat the unchanged-input early out.
+        buffer.Generate(grid, atlas, light, start, size);
+    });
+
+    auto naive = buffer.quadCount + buffer.hiddenQuadCount;
+    Log() << "layers: " << size << " view meshed in "
+        << (each * 1000000.0) << " us, " << buffer.quadCount
+        << " quads against " << naive << " for naive per-layer meshing ("
+        << (naive ? 100.0 * buffer.hiddenQuadCount / naive : 0.0)
+        << "% overdraw saved)\n";
+}
+
+static void BenchmarkAnimation()
+{
+    // A screen of nothing but animated tiles, cycling through the five
+    // dirt cells.
+    Point<int> size = {64, 48};
+    Grid grid;
+    grid.size = size;
+    grid.tiles.assign(size.x * size.y, 0x11);
+    grid.walls.assign(size.x * size.y, NoTile);
+    grid.backgrounds.assign(size.x * size.y, NoTile);
+
+    auto atlas = PackAtlas(
+        SliceSheet(LoadImage("images/sheet.png"), TileSheetCellSize),
+        TileAtlasGutter,
+        {{0x11, 5, 100}});
+
+    LightField light;
+    light.Compute(grid);
+
+    RenderGridBuffer buffer;
+    buffer.Generate(grid, atlas, light, {}, size);
+
+    // The shader advances the frames, so a frame's CPU work is the mesher
+    // noticing that nothing changed.
+    auto animated = TimeEach([&]
+    {
+        buffer.Generate(grid, atlas, light, {}, size);
+    });
+
+    // What animating on the CPU would cost: a fresh mesh every frame.
+    auto remeshed = TimeEach([&]
+    {
+        ++grid.revision;
+        buffer.Generate(grid, atlas, light, {}, size);
+    });
+
+    Log() << "animation: " << size << " view of animated tiles costs "
+        << (animated * 1000000.0) << " us per frame, against "
+        << (remeshed * 1000000.0) << " us and "
+        << (buffer.vertexData.size() * sizeof(float) / 1024)
+        << " KiB of upload per frame if remeshed\n";
+}
+
+/// Runs the idle part of WindowEventHandler::Run at 60 updates per second
+/// with each kind of pacing.
+static void BenchmarkPacing()
+{
+    auto frequency = SDL_GetPerformanceFrequency();
+    auto frameLength = frequency / 60;
+    auto toMicroseconds = 1000000.0 / double(frequency);
+
+    for (bool isPrecise : {false, true})
+    {
+        auto start = SDL_GetPerformanceCounter();
+        auto cpuStart = ProcessCpuSeconds();
+        auto lastUpdate = start;
+        Uint64 previousUpdate = 0;
+        Uint64 worstJitter = 0;
+        double jitterSum = 0.0;
+        int intervalCount = 0;
+        int sleepCount = 0;
+
+        while (intervalCount < 120)
+        {
+            auto now = SDL_GetPerformanceCounter();
+
+            if ((now - lastUpdate) >= frameLength)
+            {
+                if (previousUpdate)
+                {
+                    auto interval = now - previousUpdate;
+                    auto jitter = interval > frameLength
+                        ? interval - frameLength
+                        : frameLength - interval;
+
+                    jitterSum += double(jitter);
+                    if (jitter > worstJitter) worstJitter = jitter;
+                    ++intervalCount;
+                }
+
+                previousUpdate = now;
+                lastUpdate += frameLength;
+                continue;
+            }
+
+            ++sleepCount;
+            if (isPrecise)
+                WaitUntil(lastUpdate + frameLength);
+            else
+                SDL_Delay(1);
+        }
+
+        auto elapsed = double(SDL_GetPerformanceCounter() - start) /
+            double(frequency);
+
+        Log() << "pacing: " << (isPrecise ? "precise" : "SDL_Delay")
+            << " mean jitter " << (jitterSum / intervalCount * toMicroseconds)
+            << " us, worst " << (double(worstJitter) * toMicroseconds)
+            << " us, CPU use "
+            << ((ProcessCpuSeconds() - cpuStart) * 100.0 / elapsed)
+            << "%, " << (double(sleepCount) / intervalCount)
+            << " sleeps per update\n";
+    }
+}
+
+/// Times two frame-sized workloads on 1 to N threads, where N is the core
+/// count: a neighbor-counting pass over every tile, standing in for tile
+/// simulation, and meshing the whole world in 64x64 chunks.
+static void BenchmarkJobs()
+{
+    mt19937 mt(1);
+    auto grid = GenerateSimple({2048, 512}, mt);
+    auto tiles = grid.ToSpan2D();
+
+    auto atlas = PackAtlas(
+        SliceSheet(LoadImage("images/sheet.png"), TileSheetCellSize),
+        TileAtlasGutter);
+
+    LightField light;
+    light.Compute(grid);
+
+    vector<uint8_t> neighbors(grid.size.x * grid.size.y);
+    Span2D<uint8_t> counts = {neighbors.data(), grid.size.x, grid.size.y};
+
+    constexpr int ChunkSize = 64;
+    Point<int> chunkCount = grid.size / ChunkSize;
+    vector<RenderGridBuffer> chunks(chunkCount.x * chunkCount.y);
+    Span2D<RenderGridBuffer> chunkSpan = {
+        chunks.data(),
+        chunkCount.x,
+        chunkCount.y};
+
+    int maxThreads = Max(int(thread::hardware_concurrency()), 1);
+    double baseTilePass = 0.0;
+    double baseMeshing = 0.0;
+
+    for (int threads = 1; threads <= maxThreads; ++threads)
+    {
+        JobSystem jobs(threads - 1);
+
+        auto tilePass = TimeEach([&]
+        {
+            jobs.ParallelFor(counts, 32, [&](Span2D<uint8_t> part, int start)
+            {
+                for (int i = 0; i < part.major; ++i)
+                {
+                    int x = start + i;
+                    for (int y = 0; y < part.minor; ++y)
+                    {
+                        uint8_t count = 0;
+                        for (int dx = -1; dx <= 1; ++dx)
+                        {
+                            for (int dy = -1; dy <= 1; ++dy)
+                            {
+                                int nx = x + dx;
+                                int ny = y + dy;
+                                if ((dx || dy) &&
+                                    nx >= 0 && nx < tiles.major &&
+                                    ny >= 0 && ny < tiles.minor &&
+                                    tiles(nx, ny) != NoTile)
+                                {
+                                    ++count;
+                                }
+                            }
+                        }
+
+                        part(i, y) = count;
+                    }
+                }
+            });
+        });
+
+        auto meshing = TimeEach([&]
+        {
+            ++grid.revision;
+            jobs.ParallelFor(chunkSpan, 1, [&](
+                Span2D<RenderGridBuffer> part,
+                int start)
+            {
+                for (int j = 0; j < part.minor; ++j)
+                {
+                    part(0, j).Generate(
+                        grid,
+                        atlas,
+                        light,
+                        {start * ChunkSize, j * ChunkSize},
+                        {ChunkSize, ChunkSize});
+                }
+            });
+        });
+
+        if (threads == 1)
+        {
+            baseTilePass = tilePass;
+            baseMeshing = meshing;
+        }
+
+        Log() << "jobs: " << threads << " threads: tile pass "
+            << (tilePass * 1000.0) << " ms (x" << (baseTilePass / tilePass)
+            << "), chunk meshing " << (meshing * 1000.0) << " ms (x"
+            << (baseMeshing / meshing) << ")\n";
+    }
+}
+
+static void BenchmarkCollision()
+{
+    mt19937 mt(1);
+    auto grid = GenerateSimple({2048, 512}, mt);
+    auto tiles = grid.ToSpan2D();
+
+    constexpr int BodyCount = 10000;
+    constexpr float TickSeconds = 1.0f / 60.0f;
+    constexpr float Gravity = -40.0f;
+    constexpr float JumpSpeed = 16.0f;
+    constexpr float WalkSpeed = 6.0f;
+
+    // Player-sized walkers dropped above the terrain. They walk, turn at
+    // walls and jump whenever they land, so every tick has falls, floor
+    // contacts and wall stops.
+    vector<CollisionBody> bodies(BodyCount);
+    vector<float> walkSpeeds(BodyCount);
+    uniform_int_distribution<int> columnDistribution(1, grid.size.x - 3);
+    uniform_real_distribution<float> dropDistribution(1.0f, 24.0f);
+
+    for (int i = 0; i < BodyCount; ++i)
+    {
+        int x = columnDistribution(mt);
+        int surface = grid.size.y - 1;
+        while (surface > 0 && tiles(x, surface) == NoTile) --surface;
+
+        float bottom = float(surface + 1) + dropDistribution(mt);
+        bodies[i].box = {
+            {float(x) + 0.125f, bottom},
+            {float(x) + 0.875f, bottom + 1.75f}};
+        bodies[i].velocity = {0.0f, 0.0f};
+        bodies[i].contact = {0, 0};
+        walkSpeeds[i] = (i & 1) ? WalkSpeed : -WalkSpeed;
+    }
+
+    auto steer = [&]
+    {
+        for (int i = 0; i < BodyCount; ++i)
+        {
+            auto& body = bodies[i];
+            if (body.contact.x) walkSpeeds[i] = -walkSpeeds[i];
+            body.velocity.x = walkSpeeds[i];
+            body.velocity.y = body.contact.y > 0
+                ? JumpSpeed
+                : body.velocity.y + Gravity * TickSeconds;
+        }
+    };
+
+    Span<CollisionBody> span = {bodies.data(), BodyCount};
+    int64_t visitedCount = 0;
+    int64_t moveCount = 0;
+
+    auto serial = TimeEach(steer, [&]
+    {
+        for (auto& body : bodies)
+            visitedCount += MoveBody(grid, body, TickSeconds);
+        moveCount += BodyCount;
+    });
+
+    JobSystem jobs;
+    auto parallel = TimeEach(steer, [&]
+    {
+        MoveBodies(jobs, grid, span, TickSeconds);
+    });
+
+    auto tickBudget = 1.0 / 60.0;
+    Log() << "collision: " << BodyCount << " bodies, "
+        << (double(visitedCount) / double(moveCount))
+        << " tiles tested per move\n"
+        << "collision: serial " << (serial * 1000.0) << " ms per tick, "
+        << (BodyCount / (serial * 1000.0)) << " bodies per ms, "
+        << (serial * 100.0 / tickBudget) << "% of a 60 UPS tick\n"
+        << "collision: " << (jobs.WorkerCount() + 1) << " threads "
+        << (parallel * 1000.0) << " ms per tick, "
+        << (BodyCount / (parallel * 1000.0)) << " bodies per ms\n";
+}
+
+/// Reduced as it was before binary GCD, kept as the baseline: trial
+/// division by every odd number up to the smaller term, each only once.
+static Rational64 TrialDivisionReduced(Rational64 r)
+{
+    if (r.b == 0) return r;
+    if (r.a == 0) return {0,1};
+
+    r = Normalized(r);
+
+    bool isNegative = r.a < 0;
+
+    if (isNegative) r.a = -r.a;
+
+    if (!(r.a & 1) && !(r.b & 1)) r.a >>= 1, r.b >>= 1;
+
+    const int64_t* low = r.a < r.b ? &r.a : &r.b;
+    for (int64_t i = 3; i <= *low; i += 2)
+    {
+        if (!(r.a % i) && !(r.b % i)) r.a /= i, r.b /= i;
+    }
+
+    if (isNegative) r.a = -r.a;
+
+    return r;
+}
+
+/// operator< as it was: cross products in 64 bits.
+static bool NarrowLess(Rational64 a, Rational64 b)
+{
+    a = Normalized(a);
+    b = Normalized(b);
+    return a.a * b.b < b.a * a.b;
+}
+
+static void BenchmarkRational()
+{
+    mt19937_64 mt(1);
+
+    // Fractions with a shared factor, terms up to about 1e5 as slopes and
+    // intersections of world-sized coordinates produce.
+    constexpr int ReduceCount = 2000;
+    vector<Rational64> unreduced(ReduceCount);
+    uniform_int_distribution<int64_t> termDistribution(1, 1000);
+    uniform_int_distribution<int64_t> factorDistribution(1, 100);
+
+    for (auto& r : unreduced)
+    {
+        auto factor = factorDistribution(mt);
+        r = {termDistribution(mt) * factor, termDistribution(mt) * factor};
+        if (mt() & 1) r.a = -r.a;
+    }
+
+    int incompleteCount = 0;
+    for (auto r : unreduced)
+    {
+        if (TrialDivisionReduced(r).b != Reduced(r).b) ++incompleteCount;
+    }
+
+    // Stored to sink at the end so the timed work can't be optimized away.
+    int64_t sum = 0;
+    auto trialDivision = TimeEach([&]
+    {
+        for (auto r : unreduced) sum += TrialDivisionReduced(r).b;
+    });
+
+    auto binaryGcd = TimeEach([&]
+    {
+        for (auto r : unreduced) sum += Reduced(r).b;
+    });
+
+    // Comparisons with small terms, where both are right, and with terms
+    // near 2^40, where the 64-bit cross products overflow.
+    constexpr int CompareCount = 100000;
+    vector<Rational64> small(CompareCount + 1);
+    vector<Rational64> large(CompareCount + 1);
+    uniform_int_distribution<int64_t> smallDistribution(-100000, 100000);
+    uniform_int_distribution<int64_t> largeDistribution(
+        -(int64_t(1) << 40),
+        int64_t(1) << 40);
+
+    for (int i = 0; i <= CompareCount; ++i)
+    {
+        small[i] = {smallDistribution(mt), smallDistribution(mt) | 1};
+        large[i] = {largeDistribution(mt), largeDistribution(mt) | 1};
+    }
+
+    int wrongCount = 0;
+    for (int i = 0; i < CompareCount; ++i)
+    {
+        if (NarrowLess(large[i], large[i + 1]) != (large[i] < large[i + 1]))
+            ++wrongCount;
+    }
+
+    auto narrow = TimeEach([&]
+    {
+        for (int i = 0; i < CompareCount; ++i)
+            sum += NarrowLess(small[i], small[i + 1]);
+    });
+
+    auto wide = TimeEach([&]
+    {
+        for (int i = 0; i < CompareCount; ++i)
+            sum += small[i] < small[i + 1];
+    });
+
+    volatile int64_t sink = sum;
+    (void)sink;
+
+    Log() << "rational: reduce trial division "
+        << (trialDivision * 1e9 / ReduceCount) << " ns, binary gcd "
+        << (binaryGcd * 1e9 / ReduceCount) << " ns ("
+        << (trialDivision / binaryGcd) << "x), old result not in lowest "
+        << "terms for " << incompleteCount << " of " << ReduceCount << '\n'
+        << "rational: compare 64-bit " << (narrow * 1e9 / CompareCount)
+        << " ns, widened " << (wide * 1e9 / CompareCount) << " ns, "
+        << "64-bit wrong for " << wrongCount << " of " << CompareCount
+        << " near 2^40\n";
+}
+
+static void BenchmarkSweep(
+    const char* name,
+    const vector<LineSegment32>& segments)
+{
+    int count = int(segments.size());
+    vector<pair<int, int>> pairs;
+    vector<pair<int, int>> allPairs;
+
+    auto sweep = TimeEach([&]
+    {
+        FindIntersections({segments.data(), count}, pairs);
+    });
+
+    auto brute = TimeEach([&]
+    {
+        allPairs.clear();
+        for (int i = 0; i < count; ++i)
+        {
+            for (int j = i + 1; j < count; ++j)
+            {
+                if (SegmentsIntersect(segments[i], segments[j]))
+                    allPairs.emplace_back(i, j);
+            }
+        }
+    });
+
+    Log() << "intersections: " << name << ", " << count << " segments, "
+        << pairs.size() << " pairs" << (pairs == allPairs ? "" : " (WRONG)")
+        << ", sweep " << (sweep * 1000.0) << " ms, all pairs "
+        << (brute * 1000.0) << " ms (" << (brute / sweep) << "x)\n";
+}
+
+static void BenchmarkIntersections()
+{
+    mt19937 mt(1);
+
+    // Short segments at any angle, as light occluders.
+    vector<LineSegment32> random(5000);
+    uniform_int_distribution<int32_t> positionDistribution(0, 4095);
+    uniform_int_distribution<int32_t> offsetDistribution(-48, 48);
+
+    for (auto& segment : random)
+    {
+        segment.p1 = {positionDistribution(mt), positionDistribution(mt)};
+        segment.p2 = segment.p1 + Point32{
+            offsetDistribution(mt),
+            offsetDistribution(mt)};
+    }
+
+    BenchmarkSweep("random", random);
+
+    // Outlines of the solid tiles in a world: horizontal and vertical
+    // runs along tile edges, meeting end to end and at corners.
+    auto grid = GenerateSimple({2048, 512}, mt);
+    auto tiles = grid.ToSpan2D();
+    auto isSolid = [&](int x, int y)
+    {
+        return x >= 0 && y >= 0 && x < grid.size.x && y < grid.size.y &&
+            tiles(x, y) != NoTile;
+    };
+
+    vector<LineSegment32> outlines;
+    for (int y = 0; y <= grid.size.y; ++y)
+    {
+        for (int x = 0; x < grid.size.x; ++x)
+        {
+            if (isSolid(x, y - 1) == isSolid(x, y)) continue;
+
+            int start = x;
+            while (x + 1 < grid.size.x &&
+                isSolid(x + 1, y - 1) != isSolid(x + 1, y)) ++x;
+            outlines.push_back({{start, y}, {x + 1, y}});
+        }
+    }
+
+    for (int x = 0; x <= grid.size.x; ++x)
+    {
+        for (int y = 0; y < grid.size.y; ++y)
+        {
+            if (isSolid(x - 1, y) == isSolid(x, y)) continue;
+
+            int start = y;
+            while (y + 1 < grid.size.y &&
+                isSolid(x - 1, y + 1) != isSolid(x, y + 1)) ++y;
+            outlines.push_back({{x, start}, {x, y + 1}});
+        }
+    }
+
+    BenchmarkSweep("tile outlines", outlines);
+}
+
+static void BenchmarkRaycast()
+{
+    mt19937 mt(1);
+    auto grid = GenerateSimple({2048, 512}, mt);
+    TileOccupancy occupancy;
+    occupancy.Compute(grid);
+
+    // Batches as AI vision and lighting would cast them: 512 rays of up
+    // to 64 tiles from points anywhere in the world, so some start in
+    // open sky, some underground and some along the surface.
+    constexpr int RayCount = 512;
+    constexpr float RayLength = 64.0f;
+    vector<LineSegment<float>> rays(RayCount);
+    vector<RayHit> hits(RayCount);
+    uniform_real_distribution<float> xDistribution(0.0f, 2048.0f);
+    uniform_real_distribution<float> yDistribution(0.0f, 512.0f);
+    uniform_real_distribution<float> angleDistribution(0.0f, 6.2831853f);
+    uniform_real_distribution<float> lengthDistribution(1.0f, RayLength);
+
+    auto aim = [&]
+    {
+        for (auto& ray : rays)
+        {
+            auto angle = angleDistribution(mt);
+            auto length = lengthDistribution(mt);
+            ray.p1 = {xDistribution(mt), yDistribution(mt)};
+            ray.p2 = ray.p1 + Point<float>{cos(angle), sin(angle)} * length;
+        }
+    };
+
+    Span<const LineSegment<float>> raySpan = {rays.data(), RayCount};
+    Span<RayHit> hitSpan = {hits.data(), RayCount};
+    int64_t plainVisited = 0;
+    int64_t skippingVisited = 0;
+    int64_t plainCastCount = 0;
+    int64_t castCount = 0;
+    int64_t hitCount = 0;
+
+    auto plain = TimeEach(aim, [&]
+    {
+        for (int i = 0; i < RayCount; ++i)
+        {
+            hits[i] = CastRay(grid, rays[i]);
+            plainVisited += hits[i].visitedCount;
+        }
+        plainCastCount += RayCount;
+    });
+
+    auto skipping = TimeEach(aim, [&]
+    {
+        CastRays(grid, occupancy, raySpan, hitSpan);
+        for (const auto& hit : hits)
+        {
+            skippingVisited += hit.visitedCount;
+            hitCount += hit.isHit;
+        }
+        castCount += RayCount;
+    });
+
+    JobSystem jobs;
+    auto parallel = TimeEach(aim, [&]
+    {
+        CastRays(jobs, grid, occupancy, raySpan, hitSpan);
+    });
+
+    Log() << "raycast: " << RayCount << " rays of up to " << RayLength
+        << " tiles, " << (hitCount * 100 / castCount) << "% hit\n"
+        << "raycast: per tile " << (RayCount / plain / 1e6)
+        << " M rays/s, "
+        << (double(plainVisited) / double(plainCastCount))
+        << " tiles tested\n"
+        << "raycast: chunk skipping " << (RayCount / skipping / 1e6)
+        << " M rays/s, "
+        << (double(skippingVisited) / double(castCount))
+        << " tiles tested\n"
+        << "raycast: " << (jobs.WorkerCount() + 1) << " threads "
+        << (RayCount / parallel / 1e6) << " M rays/s\n";
+}
+
+static void BenchmarkBroadphase()
+{
+    mt19937 mt(1);
+    const Point<int> worldSize = {2048, 512};
+    constexpr int BoxCount = 10000;
+    constexpr int QueryCount = 256;
+    constexpr float TickSeconds = 1.0f / 60.0f;
+
+    // Entity-sized boxes drifting at up to 12 tiles/s, bouncing off the
+    // world's edges.
+    vector<Rectangle<float>> boxes(BoxCount);
+    vector<Point<float>> velocities(BoxCount);
+    vector<int> ids(BoxCount);
+    uniform_real_distribution<float> xDistribution(0.0f, 2040.0f);
+    uniform_real_distribution<float> yDistribution(0.0f, 504.0f);
+    uniform_real_distribution<float> sizeDistribution(0.75f, 3.0f);
+    uniform_real_distribution<float> speedDistribution(-12.0f, 12.0f);
+    Broadphase broadphase(worldSize);
+
+    for (int i = 0; i < BoxCount; ++i)
+    {
+        boxes[i].low = {xDistribution(mt), yDistribution(mt)};
+        boxes[i].high = boxes[i].low + Point<float>{
+            sizeDistribution(mt),
+            sizeDistribution(mt)};
+        velocities[i] = {speedDistribution(mt), speedDistribution(mt)};
+        ids[i] = broadphase.Insert(boxes[i]);
+    }
+
+    auto move = [&]
+    {
+        for (int i = 0; i < BoxCount; ++i)
+        {
+            auto& box = boxes[i];
+            auto& velocity = velocities[i];
+            if (box.low.x < 0.0f || box.high.x > float(worldSize.x))
+                velocity.x = -velocity.x;
+            if (box.low.y < 0.0f || box.high.y > float(worldSize.y))
+                velocity.y = -velocity.y;
+
+            auto offset = velocity * TickSeconds;
+            box.low += offset;
+            box.high += offset;
+            broadphase.Move(ids[i], box);
+        }
+    };
+
+    // Screen-sized regions, as for culling or AI perception.
+    vector<Rectangle<float>> regions(QueryCount);
+    for (auto& region : regions)
+    {
+        region.low = {xDistribution(mt), yDistribution(mt)};
+        region.high = region.low + Point<float>{32.0f, 18.0f};
+    }
+
+    vector<pair<int, int>> pairs;
+    vector<int> found;
+    int64_t foundCount = 0;
+    int64_t queryCount = 0;
+
+    // Warm up so the cell lists and results have their capacity.
+    for (int i = 0; i < 60; ++i) move();
+
+    auto moving = TimeEach([&] { move(); });
+    auto pairing = TimeEach([&] { broadphase.FindPairs(pairs); });
+    auto querying = TimeEach([&]
+    {
+        for (const auto& region : regions)
+        {
+            broadphase.Query(region, found);
+            foundCount += int64_t(found.size());
+        }
+        queryCount += QueryCount;
+    });
+
+    int64_t bruteCount = 0;
+    auto brute = TimeEach([&]
+    {
+        bruteCount = 0;
+        for (int i = 0; i < BoxCount; ++i)
+        {
+            for (int j = i + 1; j < BoxCount; ++j)
+                bruteCount += Overlaps(boxes[i], boxes[j]);
+        }
+    });
+
+    auto tick = moving + pairing + querying;
+    auto tickBudget = 1.0 / 60.0;
+    Log() << "broadphase: " << BoxCount << " moving boxes, "
+        << pairs.size() << " overlapping pairs"
+        << (int64_t(pairs.size()) == bruteCount ? "" : " (WRONG)") << '\n'
+        << "broadphase: move " << (moving * 1000.0) << " ms, pairs "
+        << (pairing * 1000.0) << " ms, " << QueryCount << " queries "
+        << (querying * 1000.0) << " ms ("
+        << (double(foundCount) / double(queryCount)) << " boxes each)\n"
+        << "broadphase: " << (tick * 1000.0) << " ms per tick, "
+        << (tick * 100.0 / tickBudget) << "% of a 60 UPS tick; all pairs "
+        << (brute * 1000.0) << " ms\n";
+}
+
+static void BenchmarkPoints()
+{
+    mt19937 mt(1);
+    constexpr int PointCount = 1 << 16;
+    uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+
+    vector<Point<float>> initialPoints(PointCount);
+    vector<Point<float>> others(PointCount);
+    for (auto& p : initialPoints) p = {distribution(mt), distribution(mt)};
+    for (auto& p : others) p = {distribution(mt), distribution(mt)};
+
+    vector<Point<float>> points(PointCount);
+    PointArray<float> pointArray(PointCount);
+    PointArray<float> otherArray;
+    otherArray.Assign({others.data(), PointCount});
+
+    // The operations work in place, so every call starts over from the
+    // same points; otherwise repeated adds and scales would wander off
+    // into huge values or denormals, differently for each side.
+    auto resetPoints = [&] { points = initialPoints; };
+    auto resetPointArray = [&]
+    {
+        pointArray.Assign({initialPoints.data(), PointCount});
+    };
+
+    vector<float> results(PointCount);
+    Span<float> resultSpan = {results.data(), PointCount};
+
+    struct Operation
+    {
+        const char* name;
+        function<void()> points;
+        function<void()> pointArray;
+    };
+
+    const Operation operations[] = {
+        {
+            "add",
+            [&]
+            {
+                for (int i = 0; i < PointCount; ++i)
+                    points[i] += others[i];
+            },
+            [&] { Add(pointArray, otherArray); }
+        },
+        {
+            "scale",
+            [&]
+            {
+                for (int i = 0; i < PointCount; ++i)
+                    points[i] = points[i] * 0.5f;
+            },
+            [&] { Scale(pointArray, 0.5f); }
+        },
+        {
+            "restrict",
+            [&]
+            {
+                for (int i = 0; i < PointCount; ++i)
+                {
+                    points[i] = points[i].Restricted(
+                        -50.0f, 50.0f, -20.0f, 20.0f);
+                }
+            },
+            [&] { Restrict(pointArray, -50.0f, 50.0f, -20.0f, 20.0f); }
+        },
+        {
+            "length squared",
+            [&]
+            {
+                for (int i = 0; i < PointCount; ++i)
+                    results[i] = LengthSquared(points[i]);
+            },
+            [&] { LengthSquared(pointArray, resultSpan); }
+        },
+        {
+            "cross z",
+            [&]
+            {
+                for (int i = 0; i < PointCount; ++i)
+                    results[i] = CrossZ(points[i], others[i]);
+            },
+            [&] { CrossZ(pointArray, otherArray, resultSpan); }
+        }};
+
+    for (const auto& operation : operations)
+    {
+        auto aos = TimeEach(resetPoints, operation.points);
+        auto soa = TimeEach(resetPointArray, operation.pointArray);
+
+        Log() << "points: " << operation.name << ", " << PointCount
+            << " points: vector<Point<float>> "
+            << (aos * 1e9 / PointCount) << " ns, PointArray "
+            << (soa * 1e9 / PointCount) << " ns per point ("
+            << (aos / soa) << "x)\n";
+    }
+}
+
+struct BenchmarkEntry
+{
+    const char* name;
+    void (*run)();
+};
+
+static const BenchmarkEntry Benchmarks[] = {
+    {"lighting", BenchmarkLighting},
+    {"layers", BenchmarkLayers},
+    {"animation", BenchmarkAnimation},
+    {"pacing", BenchmarkPacing},
+    {"jobs", BenchmarkJobs},
+    {"collision", BenchmarkCollision},
+    {"rational", BenchmarkRational},
+    {"intersections", BenchmarkIntersections},
+    {"raycast", BenchmarkRaycast},
+    {"broadphase", BenchmarkBroadphase},
+    {"points", BenchmarkPoints}};
+
+int RunBenchmark(const char* name)
+{
+    bool found = false;
+
+    for (const auto& benchmark : Benchmarks)
+    {
+        if (strcmp(name, "all") && strcmp(name, benchmark.name)) continue;
+
+        found = true;
+        benchmark.run();
+        FlushLog();
+    }
+
+    if (!found)
+    {
+        Log() << "unknown benchmark " << name << "; try one of:";
+        for (const auto& benchmark : Benchmarks) Log() << ' ' << benchmark.name;
+        Log() << " all\n";
+    }
+
+    return found ? 0 : 1;
+}
@@ -0,0 +1,8 @@
+#ifndef Benchmark_hpp
+#define Benchmark_hpp
+
+/// Runs the named benchmark, or every one for "all", and logs the
+/// results. Returns a process exit code.
+int RunBenchmark(const char* name);
+
+#endif
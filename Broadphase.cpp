@@ -0,0 +1,154 @@
+#include "Broadphase.hpp"
+#include <cmath>
+using namespace std;
+
+Broadphase::Broadphase(Point<int> worldSize)
+{
+    _cellCount = {
+        Max((worldSize.x + BroadphaseCellSize - 1) / BroadphaseCellSize, 1),
+        Max((worldSize.y + BroadphaseCellSize - 1) / BroadphaseCellSize, 1)};
+    _cells.resize(size_t(_cellCount.x) * _cellCount.y);
+}
+
+Rectangle<int> Broadphase::CellRange(Rectangle<float> box) const
+{
+    auto cellOf = [this](Point<float> p)
+    {
+        return Point<int>{
+            int(floor(p.x / float(BroadphaseCellSize))),
+            int(floor(p.y / float(BroadphaseCellSize)))}
+            .Restricted(0, _cellCount.x - 1, 0, _cellCount.y - 1);
+    };
+
+    return {cellOf(box.low), cellOf(box.high)};
+}
+
+void Broadphase::Link(int id, Rectangle<int> cells)
+{
+    for (int x = cells.low.x; x <= cells.high.x; ++x)
+    {
+        for (int y = cells.low.y; y <= cells.high.y; ++y)
+            _cells[x * _cellCount.y + y].push_back(id);
+    }
+}
+
+void Broadphase::Unlink(int id, Rectangle<int> cells)
+{
+    for (int x = cells.low.x; x <= cells.high.x; ++x)
+    {
+        for (int y = cells.low.y; y <= cells.high.y; ++y)
+        {
+            auto& cell = _cells[x * _cellCount.y + y];
+            for (auto& entry : cell)
+            {
+                if (entry != id) continue;
+
+                entry = cell.back();
+                cell.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+int Broadphase::Insert(Rectangle<float> box)
+{
+    int id;
+    if (_freeIds.empty())
+    {
+        id = int(_proxies.size());
+        _proxies.emplace_back();
+    }
+    else
+    {
+        id = _freeIds.back();
+        _freeIds.pop_back();
+    }
+
+    auto cells = CellRange(box);
+    _proxies[id] = {box, cells, true};
+    Link(id, cells);
+    ++_count;
+    return id;
+}
+
+void Broadphase::Move(int id, Rectangle<float> box)
+{
+    auto& proxy = _proxies[id];
+    proxy.box = box;
+
+    auto cells = CellRange(box);
+    if (cells.low == proxy.cells.low && cells.high == proxy.cells.high)
+        return;
+
+    Unlink(id, proxy.cells);
+    Link(id, cells);
+    proxy.cells = cells;
+}
+
+void Broadphase::Remove(int id)
+{
+    auto& proxy = _proxies[id];
+    if (!proxy.isActive) return;
+
+    Unlink(id, proxy.cells);
+    proxy.isActive = false;
+    _freeIds.push_back(id);
+    --_count;
+}
+
+void Broadphase::Query(Rectangle<float> region, vector<int>& ids) const
+{
+    ids.clear();
+    auto range = CellRange(region);
+
+    for (int x = range.low.x; x <= range.high.x; ++x)
+    {
+        for (int y = range.low.y; y <= range.high.y; ++y)
+        {
+            for (auto id : _cells[x * _cellCount.y + y])
+            {
+                const auto& proxy = _proxies[id];
+
+                // A box in several of these cells is reported from the
+                // first one only.
+                if (x != Max(proxy.cells.low.x, range.low.x) ||
+                    y != Max(proxy.cells.low.y, range.low.y)) continue;
+
+                if (Overlaps(proxy.box, region)) ids.push_back(id);
+            }
+        }
+    }
+}
+
+void Broadphase::FindPairs(vector<pair<int, int>>& pairs) const
+{
+    pairs.clear();
+
+    for (int x = 0; x < _cellCount.x; ++x)
+    {
+        for (int y = 0; y < _cellCount.y; ++y)
+        {
+            const auto& cell = _cells[x * _cellCount.y + y];
+            auto count = cell.size();
+
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& a = _proxies[cell[i]];
+
+                for (size_t j = i + 1; j < count; ++j)
+                {
+                    const auto& b = _proxies[cell[j]];
+                    if (!Overlaps(a.box, b.box)) continue;
+
+                    // Boxes sharing several cells meet in each of them;
+                    // only the first shared cell reports them.
+                    if (x != Max(a.cells.low.x, b.cells.low.x) ||
+                        y != Max(a.cells.low.y, b.cells.low.y)) continue;
+
+                    pairs.push_back(minmax(cell[i], cell[j]));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef Broadphase_hpp
+#define Broadphase_hpp
+
+#include "Rectangle.hpp"
+#include <utility>
+#include <vector>
+
+/// Side of a broadphase cell, in tiles. Cell edges fall on tile edges.
+constexpr int BroadphaseCellSize = 8;
+
+/// Index of moving boxes, such as entities, for finding which ones overlap
+/// without testing every pair. A uniform grid of cells over the world;
+/// each box is listed in every cell it touches, and boxes past the world's
+/// edge count as in the border cells.
+///
+/// Once the cell lists and the caller's result vectors have grown to fit,
+/// nothing allocates: ids are reused, and a move that stays within the
+/// same cells only stores the new box.
+class Broadphase
+{
+    struct Proxy
+    {
+        Rectangle<float> box;
+        Rectangle<int> cells;
+        bool isActive;
+    };
+
+    Point<int> _cellCount = {};
+    std::vector<std::vector<int>> _cells;
+    std::vector<Proxy> _proxies;
+    std::vector<int> _freeIds;
+    int _count = 0;
+
+    Rectangle<int> CellRange(Rectangle<float> box) const;
+    void Link(int id, Rectangle<int> cells);
+    void Unlink(int id, Rectangle<int> cells);
+
+public:
+    /// Covers a world of worldSize tiles.
+    explicit Broadphase(Point<int> worldSize);
+
+    /// Returns the id of the new box, valid until it's removed.
+    int Insert(Rectangle<float> box);
+    void Move(int id, Rectangle<float> box);
+    void Remove(int id);
+
+    inline Rectangle<float> Box(int id) const { return _proxies[id].box; }
+    inline int Count() const { return _count; }
+
+    /// Sets ids to every box that overlaps region.
+    void Query(Rectangle<float> region, std::vector<int>& ids) const;
+
+    /// Sets pairs to every (a, b), a < b, of overlapping boxes, each once.
+    void FindPairs(std::vector<std::pair<int, int>>& pairs) const;
+};
+
+#endif
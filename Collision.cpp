@@ -0,0 +1,198 @@
+#include "Collision.hpp"
+#include "Jobs.hpp"
+#include <cmath>
+#include <limits>
+using namespace std;
+
+/// Slack for float error: an edge within Epsilon of a grid line is on it.
+static constexpr float Epsilon = 1.0f / 4096.0f;
+
+/// Enough for one stop per axis plus a corner.
+static constexpr int MaxSlides = 3;
+
+/// Bodies per job when a batch is split.
+static constexpr int BodyGrain = 256;
+
+static inline bool IsSolid(const Grid& grid, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= grid.size.x || y >= grid.size.y) return true;
+    return grid.tiles[size_t(x) * grid.size.y + y] != NoTile;
+}
+
+/// First and last cells that low..high overlaps by more than Epsilon.
+static inline int FirstCell(float low)
+{
+    return int(floor(low + Epsilon));
+}
+
+static inline int LastCell(float high)
+{
+    return int(ceil(high - Epsilon)) - 1;
+}
+
+/// One axis of a sweep: where the leading edge starts, and the next grid
+/// line it reaches and when.
+struct AxisSweep
+{
+    int step = 0;
+    int boundary = 0;
+    float edge = 0.0f;
+    float motion = 0.0f;
+    float time = numeric_limits<float>::infinity();
+
+    AxisSweep(float low, float high, float delta) : motion(delta)
+    {
+        if (delta > 0.0f)
+        {
+            step = 1;
+            edge = high;
+            boundary = int(ceil(high - Epsilon));
+        }
+        else if (delta < 0.0f)
+        {
+            step = -1;
+            edge = low;
+            boundary = int(floor(low + Epsilon));
+        }
+        else
+        {
+            return;
+        }
+
+        time = Max((float(boundary) - edge) / motion, 0.0f);
+    }
+
+    /// The cell the leading edge enters at boundary.
+    inline int Cell() const
+    {
+        return step > 0 ? boundary : boundary - 1;
+    }
+
+    /// Cells low..high covers at time t. On the leading side this counts
+    /// every cell already entered, even one only touched, so a cell the
+    /// other axis tested can't drop out through the Epsilon slack.
+    inline void Range(float low, float high, float t, int& first, int& last)
+        const
+    {
+        first = step < 0 ? boundary : FirstCell(low + motion * t);
+        last = step > 0 ? boundary - 1 : LastCell(high + motion * t);
+    }
+
+    inline void Advance()
+    {
+        boundary += step;
+        time = (float(boundary) - edge) / motion;
+    }
+};
+
+SweepHit SweepBox(const Grid& grid, Rectangle<float> box, Point<float> motion)
+{
+    SweepHit hit;
+    AxisSweep x(box.low.x, box.high.x, motion.x);
+    AxisSweep y(box.low.y, box.high.y, motion.y);
+
+    // Walk the grid lines both leading edges cross, in time order, and
+    // test the row or column of cells each one opens up.
+    while (true)
+    {
+        bool isX = x.time <= y.time;
+        auto& axis = isX ? x : y;
+        if (!(axis.time <= 1.0f)) break;
+
+        float t = axis.time;
+        int cell = axis.Cell();
+        int first;
+        int last;
+
+        if (isX)
+            y.Range(box.low.y, box.high.y, t, first, last);
+        else
+            x.Range(box.low.x, box.high.x, t, first, last);
+
+        for (int i = first; i <= last; ++i)
+        {
+            ++hit.visitedCount;
+            Point<int> tile = isX ? Point<int>{cell, i} : Point<int>{i, cell};
+            if (!IsSolid(grid, tile.x, tile.y)) continue;
+
+            hit.time = t;
+            hit.normal = isX
+                ? Point<int>{-axis.step, 0}
+                : Point<int>{0, -axis.step};
+            hit.tile = tile;
+            return hit;
+        }
+
+        axis.Advance();
+    }
+
+    return hit;
+}
+
+int MoveBody(const Grid& grid, CollisionBody& body, float seconds)
+{
+    int visitedCount = 0;
+    auto remaining = body.velocity * seconds;
+    body.contact = {0, 0};
+
+    for (int i = 0; i < MaxSlides; ++i)
+    {
+        if (remaining.x == 0.0f && remaining.y == 0.0f) break;
+
+        auto hit = SweepBox(grid, body.box, remaining);
+        auto moved = remaining * hit.time;
+        body.box.low += moved;
+        body.box.high += moved;
+        visitedCount += hit.visitedCount;
+        if (hit.time >= 1.0f) break;
+
+        remaining = remaining * (1.0f - hit.time);
+
+        // Put the edge exactly on the face, so rounding can never leave
+        // the box inside the tile for the next sweep.
+        if (hit.normal.x)
+        {
+            auto width = body.box.high.x - body.box.low.x;
+            body.box.low.x = hit.normal.x > 0
+                ? float(hit.tile.x + 1)
+                : float(hit.tile.x) - width;
+            body.box.high.x = body.box.low.x + width;
+            remaining.x = 0.0f;
+            body.velocity.x = 0.0f;
+            body.contact.x = hit.normal.x;
+        }
+        else
+        {
+            auto height = body.box.high.y - body.box.low.y;
+            body.box.low.y = hit.normal.y > 0
+                ? float(hit.tile.y + 1)
+                : float(hit.tile.y) - height;
+            body.box.high.y = body.box.low.y + height;
+            remaining.y = 0.0f;
+            body.velocity.y = 0.0f;
+            body.contact.y = hit.normal.y;
+        }
+    }
+
+    return visitedCount;
+}
+
+void MoveBodies(const Grid& grid, Span<CollisionBody> bodies, float seconds)
+{
+    for (auto& body : bodies) MoveBody(grid, body, seconds);
+}
+
+void MoveBodies(
+    JobSystem& jobs,
+    const Grid& grid,
+    Span<CollisionBody> bodies,
+    float seconds)
+{
+    Span2D<CollisionBody> span = {bodies.data, bodies.count, 1};
+
+    jobs.ParallelFor(span, BodyGrain, [&](Span2D<CollisionBody> part, int)
+    {
+        for (int i = 0; i < part.major; ++i)
+            MoveBody(grid, part(i, 0), seconds);
+    });
+}
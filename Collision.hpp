@@ -0,0 +1,56 @@
+#ifndef Collision_hpp
+#define Collision_hpp
+
+#include "Grid.hpp"
+#include "Rectangle.hpp"
+#include "Span.hpp"
+
+class JobSystem;
+
+/// Collision of axis-aligned boxes against the solid (foreground) tiles of
+/// a Grid. Units are tiles: tile (x, y) covers [x, x + 1] by [y, y + 1].
+/// Everything outside the grid counts as solid.
+
+struct SweepHit
+{
+    /// Fraction of the motion completed before contact; 1 means no hit.
+    float time = 1.0f;
+
+    /// Face normal of the tile that was hit, pointing back at the box.
+    Point<int> normal = {0, 0};
+    Point<int> tile = {0, 0};
+
+    /// Tiles tested on the way, for checking that sweeps stay cheap.
+    int visitedCount = 0;
+};
+
+/// Sweeps box along motion and returns the first contact. Only the tiles
+/// the leading edges move into are tested, in the order they are reached.
+/// Tiles the box already overlaps, and faces it only touches, are ignored.
+SweepHit SweepBox(const Grid& grid, Rectangle<float> box, Point<float> motion);
+
+struct CollisionBody
+{
+    Rectangle<float> box;
+    Point<float> velocity;
+
+    /// Normals of the faces touched during the last move; {0, 1} means the
+    /// body is standing on something.
+    Point<int> contact;
+};
+
+/// Moves body by velocity * seconds, stopping at each contact and sliding
+/// along it with the velocity into the surface removed. Returns how many
+/// tiles were tested.
+int MoveBody(const Grid& grid, CollisionBody& body, float seconds);
+
+/// Moves every body. Bodies don't collide with each other, so the batch
+/// splits freely across jobs.
+void MoveBodies(const Grid& grid, Span<CollisionBody> bodies, float seconds);
+void MoveBodies(
+    JobSystem& jobs,
+    const Grid& grid,
+    Span<CollisionBody> bodies,
+    float seconds);
+
+#endif
@@ -1,24 +1,320 @@
 #include "Debug.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
 
-static std::ostream* theLogStreams[16];
-static Logger theLogger = {theLogStreams, 0};
+/// Bytes each thread can have waiting for the writer.
+static constexpr size_t RingSize = 1 << 16;
 
-Logger Log()
+/// How long the writer sleeps between passes when nothing wakes it.
+static constexpr chrono::milliseconds WriteInterval(10);
+
+static constexpr size_t CacheLineSize = 64;
+
+/// Byte queue with one producer (its thread) and one consumer (whoever
+/// holds theMutex). Head and tail only grow, and each sits on its own
+/// cache line.
+struct LogRing
+{
+    atomic<size_t> head{0};
+    char headPadding[CacheLineSize - sizeof(atomic<size_t>)];
+    atomic<size_t> tail{0};
+    char tailPadding[CacheLineSize - sizeof(atomic<size_t>)];
+    char bytes[RingSize];
+};
+
+/// Formats into a fixed buffer. When the buffer fills, its bytes are
+/// staged in the ring past the published head, so long statements are
+/// split, not truncated. Commit publishes the whole statement at once, so
+/// the writer never sees part of one and statements never interleave. A
+/// statement that outgrows the ring's free space is dropped whole.
+class LogBuffer : public streambuf
+{
+public:
+    explicit LogBuffer(LogRing& ring) : _ring(ring)
+    {
+        setp(_bytes, _bytes + sizeof(_bytes));
+    }
+
+    /// Ends the statement.
+    void Commit();
+
+protected:
+    int_type overflow(int_type c) override;
+
+private:
+    void Stage();
+
+    LogRing& _ring;
+
+    /// End of the staged bytes; the ring's head once they are published.
+    size_t _head = 0;
+    bool _isDropping = false;
+    char _bytes[1024];
+};
+
+struct ThreadLog
+{
+    ThreadLog();
+    ~ThreadLog();
+
+    LogRing* ring;
+    LogBuffer buffer;
+    ostream stream;
+};
+
+/// Drains the rings in the background while any stream is attached.
+class LogWriter
+{
+public:
+    ~LogWriter() { Stop(); }
+
+    void Start();
+    void Stop();
+
+private:
+    void Loop();
+
+    thread _thread;
+    bool _isStopping = false;
+};
+
+// theMutex guards the ring list, the streams, and the consuming side of
+// every ring. Producers only take it when their thread starts or ends.
+static mutex theMutex;
+static condition_variable theWake;
+static vector<unique_ptr<LogRing>> theRings;
+static vector<ostream*> theStreams;
+static atomic<size_t> theStreamCount{0};
+static atomic<uint64_t> theDroppedCount{0};
+static atomic<int> theLogLevel{DebugLevel};
+static uint64_t theReportedDropCount = 0;
+static LogWriter theWriter;
+
+/// Writes what the ring holds to the streams. theMutex must be held.
+static bool Drain(LogRing& ring)
+{
+    auto tail = ring.tail.load(memory_order_relaxed);
+    auto head = ring.head.load(memory_order_acquire);
+    if (head == tail) return false;
+
+    auto start = tail % RingSize;
+    auto count = head - tail;
+    auto first = min(count, RingSize - start);
+
+    for (auto stream : theStreams)
+    {
+        stream->write(ring.bytes + start, first);
+        if (count > first) stream->write(ring.bytes, count - first);
+    }
+
+    ring.tail.store(head, memory_order_release);
+    return true;
+}
+
+/// Drains every ring and reports any drops. theMutex must be held.
+static bool DrainAll()
+{
+    bool didWrite = false;
+    for (auto& ring : theRings) didWrite = Drain(*ring) || didWrite;
+
+    auto dropped = theDroppedCount.load(memory_order_relaxed);
+    if (dropped != theReportedDropCount)
+    {
+        for (auto stream : theStreams)
+        {
+            *stream << "[log] dropped " << (dropped - theReportedDropCount)
+                << " statements\n";
+        }
+
+        theReportedDropCount = dropped;
+        didWrite = true;
+    }
+
+    return didWrite;
+}
+
+void LogBuffer::Stage()
+{
+    auto count = size_t(pptr() - pbase());
+    if (!count) return;
+    setp(_bytes, _bytes + sizeof(_bytes));
+
+    // Nobody would read it, or the statement is already lost.
+    if (_isDropping || !theStreamCount.load(memory_order_relaxed)) return;
+
+    auto used = _head - _ring.tail.load(memory_order_acquire);
+
+    if (count > RingSize - used)
+    {
+        _isDropping = true;
+        _head = _ring.head.load(memory_order_relaxed);
+        return;
+    }
+
+    auto start = _head % RingSize;
+    auto first = min(count, RingSize - start);
+    memcpy(_ring.bytes + start, _bytes, first);
+    memcpy(_ring.bytes, _bytes + first, count - first);
+    _head += count;
+}
+
+void LogBuffer::Commit()
+{
+    Stage();
+
+    if (_isDropping)
+    {
+        _isDropping = false;
+        theDroppedCount.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+
+    auto head = _ring.head.load(memory_order_relaxed);
+    if (_head == head) return;
+
+    auto tail = _ring.tail.load(memory_order_acquire);
+    _ring.head.store(_head, memory_order_release);
+
+    // Wake the writer early rather than let a burst fill the ring.
+    if (head - tail < RingSize / 2 && _head - tail >= RingSize / 2)
+        theWake.notify_one();
+}
+
+LogBuffer::int_type LogBuffer::overflow(int_type c)
 {
-    return theLogger;
+    Stage();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+}
+
+static LogRing* AddRing()
+{
+    lock_guard<mutex> lock(theMutex);
+    theRings.push_back(make_unique<LogRing>());
+    return theRings.back().get();
+}
+
+ThreadLog::ThreadLog() : ring(AddRing()), buffer(*ring), stream(&buffer)
+{
+}
+
+ThreadLog::~ThreadLog()
+{
+    buffer.Commit();
+
+    lock_guard<mutex> lock(theMutex);
+    Drain(*ring);
+
+    theRings.erase(find_if(theRings.begin(), theRings.end(),
+        [this](const unique_ptr<LogRing>& other)
+        {
+            return other.get() == ring;
+        }));
+}
+
+static ThreadLog& ThisThreadLog()
+{
+    thread_local ThreadLog log;
+    return log;
+}
+
+void LogWriter::Start()
+{
+    if (!_thread.joinable()) _thread = thread([this] { Loop(); });
+}
+
+void LogWriter::Stop()
+{
+    if (!_thread.joinable()) return;
+
+    {
+        lock_guard<mutex> lock(theMutex);
+        _isStopping = true;
+    }
+
+    theWake.notify_all();
+    _thread.join();
+    _isStopping = false;
+}
+
+void LogWriter::Loop()
+{
+    unique_lock<mutex> lock(theMutex);
+
+    while (!_isStopping)
+    {
+        if (DrainAll())
+        {
+            for (auto stream : theStreams) stream->flush();
+        }
+
+        theWake.wait_for(lock, WriteInterval);
+    }
+}
+
+LogLine::~LogLine()
+{
+    if (_stream) static_cast<LogBuffer*>(_stream->rdbuf())->Commit();
+}
+
+LogLine Log()
+{
+    return LogLine(ThisThreadLog().stream);
 }
 
 void AddLogStream(std::ostream& stream)
 {
-    theLogger.data[theLogger.count++] = &stream;
+    {
+        lock_guard<mutex> lock(theMutex);
+        theStreams.push_back(&stream);
+        theStreamCount.store(theStreams.size(), memory_order_relaxed);
+    }
+
+    theWriter.Start();
 }
 
 void RemoveAllLogStreams()
 {
-    theLogger.count = 0;
+    FlushLog();
+    theWriter.Stop();
+
+    lock_guard<mutex> lock(theMutex);
+    theStreams.clear();
+    theStreamCount.store(0, memory_order_relaxed);
 }
 
 void FlushLog()
 {
-    for (auto stream : theLogger) stream->flush();
+    lock_guard<mutex> lock(theMutex);
+    DrainAll();
+    for (auto stream : theStreams) stream->flush();
+}
+
+LogLevel GetLogLevel()
+{
+    return LogLevel(theLogLevel.load(memory_order_relaxed));
+}
+
+void SetLogLevel(LogLevel level)
+{
+    theLogLevel.store(level, memory_order_relaxed);
+}
+
+uint64_t DroppedLogCount()
+{
+    return theDroppedCount.load(memory_order_relaxed);
 }
@@ -1,22 +1,91 @@
 #ifndef Debug_hpp
 #define Debug_hpp
 
-#include "Span.hpp"
 #include <iostream>
+#include <cstdint>
 #include <utility>
 
-typedef Span<std::ostream*> Logger;
+/// One logging statement. Values are formatted into the calling thread's
+/// own buffer; when the statement ends, the bytes are copied into that
+/// thread's ring, and a background thread writes them to the log streams.
+class LogLine
+{
+public:
+    explicit LogLine(std::ostream& stream) : _stream(&stream) {}
+
+    LogLine(LogLine&& other) : _stream(other._stream)
+    {
+        other._stream = nullptr;
+    }
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+    ~LogLine();
+
+    template<class T> LogLine& operator<<(T&& value)
+    {
+        *_stream << std::forward<T>(value);
+        return *this;
+    }
 
-template<class T> Logger operator<<(Logger streams, T&& value)
+    LogLine& operator<<(std::ostream& (*manipulator)(std::ostream&))
+    {
+        *_stream << manipulator;
+        return *this;
+    }
+
+private:
+    std::ostream* _stream;
+};
+
+/// Writes regardless of level; reports the user asked for use this.
+LogLine Log();
+
+enum LogLevel
 {
-    for (auto stream : streams) *stream << std::forward<T>(value);
-    return streams;
-}
+    DebugLevel,
+    InfoLevel,
+    WarningLevel,
+    ErrorLevel
+};
 
-Logger Log();
+#ifndef KerrariaLogLevel
+#define KerrariaLogLevel 0
+#endif
+
+/// Statements below this level are compiled out: make LOG_LEVEL=N.
+constexpr int CompiledLogLevel = KerrariaLogLevel;
+
+/// Runtime threshold for the levels that were compiled in.
+LogLevel GetLogLevel();
+void SetLogLevel(LogLevel level);
+
+/// Swallows a finished statement so that LOG_AT stays one expression.
+struct LogVoidify
+{
+    void operator&(const LogLine&) {}
+};
+
+/// LOG_INFO << "text" << value << '\n'; The operands are evaluated only if
+/// the level is enabled, and the optimizer drops the whole statement when
+/// the level is below CompiledLogLevel.
+#define LOG_AT(level) \
+    ((level) < CompiledLogLevel || (level) < GetLogLevel()) \
+        ? (void)0 : LogVoidify() & Log()
+#define LOG_DEBUG LOG_AT(DebugLevel)
+#define LOG_INFO LOG_AT(InfoLevel)
+#define LOG_WARNING LOG_AT(WarningLevel)
+#define LOG_ERROR LOG_AT(ErrorLevel)
 
 void AddLogStream(std::ostream& stream);
 void RemoveAllLogStreams();
+
+/// Writes everything logged so far to the log streams and flushes them.
+/// Only the bytes already queued are waited for, so the call stays short
+/// even while other threads keep logging.
 void FlushLog();
 
+/// Statements lost because their thread's ring was full.
+uint64_t DroppedLogCount();
+
 #endif
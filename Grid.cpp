@@ -1,9 +1,11 @@
 #include "Grid.hpp"
 #include "Span.hpp"
+#include "Profile.hpp"
 using namespace std;
 
 Grid GenerateSimple(Point<int> size, mt19937& mt)
 {
+    PROFILE_ZONE("GenerateSimple");
     Grid result;
     
     if (size.x < 1 || size.y < 1)
@@ -14,7 +16,11 @@ Grid GenerateSimple(Point<int> size, mt19937& mt)
     span.major = size.x;
     span.minor = size.y;
     result.tiles.resize(span.Count(), NoTile);
+    result.walls.resize(span.Count(), NoTile);
+    result.backgrounds.resize(span.Count(), NoTile);
     span.data = result.tiles.data();
+    auto walls = result.ToSpan2D(WallLayer);
+    auto backgrounds = result.ToSpan2D(BackgroundLayer);
 
     normal_distribution<double> slopeDistribution(0.0, 2.0);
     double previousSlope = 0.0;
@@ -41,6 +47,11 @@ Grid GenerateSimple(Point<int> size, mt19937& mt)
             for (int k = 0; k < n; ++k)
             {
                 span(i + j, n - 1 - k) = k ? stoneDist(mt) : grassTopDist(mt);
+
+                // Walls and backgrounds come from position alone, so the
+                // foreground for a given seed is unchanged.
+                backgrounds(i + j, n - 1 - k) = 0x10;
+                if (k) walls(i + j, n - 1 - k) = 0x11 + (i + j + k) % 5;
             }
         }
         
@@ -50,3 +61,27 @@ Grid GenerateSimple(Point<int> size, mt19937& mt)
 
     return result;
 }
+
+uint64_t Checksum(const Grid& grid)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    auto add = [&hash](const void* data, size_t size)
+    {
+        auto bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3;
+        }
+    };
+
+    add(&grid.size, sizeof(grid.size));
+
+    for (int i = 0; i < GridLayerCount; ++i)
+    {
+        const auto& layer = grid.Layer(GridLayer(i));
+        add(layer.data(), layer.size() * sizeof(layer[0]));
+    }
+
+    return hash;
+}
@@ -9,14 +9,53 @@
 
 constexpr uint16_t NoTile = 0xffff;
 
+/// Co-registered tile layers, front to back.
+enum GridLayer
+{
+    ForegroundLayer, // Solid tiles. These collide and block light.
+    WallLayer, // Placed behind the foreground, exposed by mining.
+    BackgroundLayer, // Scenery behind everything else.
+    GridLayerCount
+};
+
 struct Grid
 {
-    std::vector<uint16_t> tiles;
+    std::vector<uint16_t> tiles; // Foreground layer.
+    std::vector<uint16_t> walls;
+    std::vector<uint16_t> backgrounds;
     Point<int> size = {};
+    uint32_t revision = 0; // Bumped on every edit so caches can notice.
+
+    inline std::vector<uint16_t>& Layer(GridLayer layer)
+    {
+        return layer == WallLayer ? walls :
+            layer == BackgroundLayer ? backgrounds : tiles;
+    }
 
-    inline Span2D<uint16_t> ToSpan2D() { return {tiles.data(), size.x, size.y}; }
+    inline const std::vector<uint16_t>& Layer(GridLayer layer) const
+    {
+        return layer == WallLayer ? walls :
+            layer == BackgroundLayer ? backgrounds : tiles;
+    }
+
+    inline Span2D<uint16_t> ToSpan2D(GridLayer layer = ForegroundLayer)
+    {
+        return {Layer(layer).data(), size.x, size.y};
+    }
+
+    inline void Set(
+        Point<int> position,
+        uint16_t tile,
+        GridLayer layer = ForegroundLayer)
+    {
+        ToSpan2D(layer)(position.x, position.y) = tile;
+        ++revision;
+    }
 };
 
 Grid GenerateSimple(Point<int> size, std::mt19937& mt);
 
+/// FNV-1a over the size and every layer, for comparing runs and builds.
+uint64_t Checksum(const Grid& grid);
+
 #endif
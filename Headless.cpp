@@ -0,0 +1,371 @@
+#include "Headless.hpp"
+#include "Renderer.hpp"
+#include "TestHandler.hpp"
+#include "InputLog.hpp"
+#include "Process.hpp"
+#include "Debug.hpp"
+#include <SDL.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+using namespace std;
+
+static constexpr float PixelsPerSpace = 64.0f;
+
+static const char* GetString(GLenum name)
+{
+    auto text = (const char*)glGetString(name);
+    return text ? text : "(null)";
+}
+
+static double ToMicroseconds(Uint64 ticks)
+{
+    return double(ticks) * 1000000.0 / double(SDL_GetPerformanceFrequency());
+}
+
+static void LogTimes(const char* label, vector<Uint64> times)
+{
+    if (times.empty()) return;
+
+    sort(times.begin(), times.end());
+
+    Uint64 total = 0;
+    for (auto t : times) total += t;
+
+    auto at = [&](double fraction)
+    {
+        return ToMicroseconds(times[size_t(fraction * (times.size() - 1))]);
+    };
+
+    Log() << label << " (us): mean "
+        << (ToMicroseconds(total) / double(times.size()))
+        << " min " << at(0.0)
+        << " p50 " << at(0.5)
+        << " p95 " << at(0.95)
+        << " max " << at(1.0) << '\n';
+}
+
+/// Binary PPM, flipped so the top row comes first.
+static void DumpFramebuffer(Point<int> size, const string& path)
+{
+    vector<uint8_t> pixels(size.x * size.y * 4);
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+    ofstream stream(path, ofstream::binary);
+    stream << "P6\n" << size.x << ' ' << size.y << "\n255\n";
+
+    for (int y = size.y - 1; y >= 0; --y)
+    {
+        for (int x = 0; x < size.x; ++x)
+            stream.write((const char*)&pixels[(y * size.x + x) * 4], 3);
+    }
+
+    if (!stream) LOG_ERROR << "failed to write " << path << '\n';
+}
+
+/// Renders the frames with whatever GL context is current.
+static void RenderFrames(const HeadlessOptions& options)
+{
+    mt19937 mt(options.seed);
+    auto grid = GenerateSimple({256, 128}, mt);
+    LightField light;
+    light.Compute(grid);
+
+    Renderer renderer;
+    RenderGridBuffer buffer;
+    auto displaySize = options.displaySize;
+
+    glViewport(0, 0, displaySize.x, displaySize.y);
+
+    Point<float> space = {
+        float(displaySize.x) / PixelsPerSpace,
+        float(displaySize.y) / PixelsPerSpace};
+    auto halfSpace = space / 2.0f;
+    auto viewSize = (space.Cast<int>() + Point<int>{2, 2})
+        .Restricted(1, grid.size.x, 1, grid.size.y);
+    auto projection = Orthographic(
+        -halfSpace.x,
+        halfSpace.x,
+        -halfSpace.y,
+        halfSpace.y,
+        1.0f,
+        -1.0f);
+
+    vector<Uint64> prepareTimes;
+    vector<Uint64> renderTimes;
+    vector<Uint64> finishTimes;
+
+    for (int frame = 0; frame < options.frameCount; ++frame)
+    {
+        auto start = SDL_GetPerformanceCounter();
+
+        // Sweep back and forth across the world while bobbing vertically,
+        // so the visible window keeps crossing tile boundaries.
+        float phase = float(frame) / 240.0f;
+        Point<float> center = {
+            halfSpace.x + (grid.size.x - space.x) *
+                (0.5f - 0.5f * cos(phase * 3.14159265f)),
+            float(grid.size.y) / 2.0f + sin(phase * 7.0f) * 8.0f};
+        center.y = Restricted(center.y, halfSpace.y, grid.size.y - halfSpace.y);
+
+        auto offset = (center - halfSpace)
+            .Cast<int>()
+            .Restricted(
+                0,
+                grid.size.x - viewSize.x,
+                0,
+                grid.size.y - viewSize.y);
+
+        buffer.Generate(grid, renderer.Atlas(), light, offset, viewSize);
+
+        auto translation = -center + offset.Cast<float>();
+        buffer.matrix = projection *
+            Translate(translation.x, translation.y, 0.0f);
+
+        auto prepared = SDL_GetPerformanceCounter();
+        renderer.Render(buffer);
+        auto rendered = SDL_GetPerformanceCounter();
+
+        // Keep GPU time out of the CPU numbers above.
+        glFinish();
+        auto finished = SDL_GetPerformanceCounter();
+
+        prepareTimes.push_back(prepared - start);
+        renderTimes.push_back(rendered - prepared);
+        finishTimes.push_back(finished - rendered);
+
+        if (options.dumpPrefix &&
+            options.dumpInterval > 0 &&
+            !(frame % options.dumpInterval))
+        {
+            DumpFramebuffer(
+                displaySize,
+                options.dumpPrefix + to_string(frame) + ".ppm");
+        }
+    }
+
+    Log() << options.frameCount << " headless frames at "
+        << displaySize.x << "x" << displaySize.y
+        << " (seed " << options.seed << ")\n";
+    LogTimes("prepare", move(prepareTimes));
+    LogTimes("render", move(renderTimes));
+    LogTimes("finish", move(finishTimes));
+}
+
+#ifdef _WIN32
+
+template<typename F> static int RunInContext(Point<int> size, F&& body)
+{
+    (void)size;
+    (void)body;
+    LOG_ERROR << "headless mode needs EGL and is not available here\n";
+    return 1;
+}
+
+#else
+
+/// Prefers Mesa's surfaceless platform, which needs neither a GPU nor a
+/// display server. The default display works too when one is around.
+static EGLDisplay GetDisplay()
+{
+    auto extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+        eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (extensions &&
+        strstr(extensions, "EGL_MESA_platform_surfaceless") &&
+        getPlatformDisplay)
+    {
+        auto display = getPlatformDisplay(
+            EGL_PLATFORM_SURFACELESS_MESA,
+            EGL_DEFAULT_DISPLAY,
+            nullptr);
+
+        if (display != EGL_NO_DISPLAY) return display;
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+/// Creates an offscreen context with a size x size pbuffer, makes it
+/// current, and calls body. Returns a process exit code.
+template<typename F> static int RunInContext(Point<int> size, F&& body)
+{
+    auto display = GetDisplay();
+
+    EGLint major;
+    EGLint minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+    {
+        LOG_ERROR << "failed to initialize EGL\n";
+        return 1;
+    }
+
+#ifdef KerrariaES2
+    constexpr EGLint RenderableType = EGL_OPENGL_ES2_BIT;
+    constexpr EGLenum Api = EGL_OPENGL_ES_API;
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE};
+#else
+    constexpr EGLint RenderableType = EGL_OPENGL_BIT;
+    constexpr EGLenum Api = EGL_OPENGL_API;
+    const EGLint contextAttributes[] = {EGL_NONE};
+#endif
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, RenderableType,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE};
+
+    const EGLint surfaceAttributes[] = {
+        EGL_WIDTH, size.x,
+        EGL_HEIGHT, size.y,
+        EGL_NONE};
+
+    EGLConfig config;
+    EGLint configCount = 0;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+    int result = 1;
+
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) ||
+        configCount < 1)
+    {
+        LOG_ERROR << "no EGL pbuffer config\n";
+    }
+    else if (!eglBindAPI(Api))
+    {
+        LOG_ERROR << "failed to bind EGL API\n";
+    }
+    else if ((surface = eglCreatePbufferSurface(
+            display,
+            config,
+            surfaceAttributes)) == EGL_NO_SURFACE)
+    {
+        LOG_ERROR << "failed to create EGL pbuffer\n";
+    }
+    else if ((context = eglCreateContext(
+            display,
+            config,
+            EGL_NO_CONTEXT,
+            contextAttributes)) == EGL_NO_CONTEXT)
+    {
+        LOG_ERROR << "failed to create EGL context\n";
+    }
+    else if (!eglMakeCurrent(display, surface, surface, context))
+    {
+        LOG_ERROR << "failed to make EGL context current\n";
+    }
+    else
+    {
+#ifndef KerrariaES2
+        // glewInit would look for a GLX display, which may not exist.
+        glewContextInit();
+#endif
+
+        LOG_INFO << "EGL " << major << "." << minor
+            << "\nOpenGL Renderer: " << GetString(GL_RENDERER)
+            << "\nOpenGL Version: " << GetString(GL_VERSION)
+            << '\n';
+
+        body();
+        result = 0;
+    }
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+    eglTerminate(display);
+
+    return result;
+}
+
+#endif
+
+int RunHeadless(const HeadlessOptions& options)
+{
+    return RunInContext(options.displaySize, [&] { RenderFrames(options); });
+}
+
+/// Feeds the log through a fresh TestHandler and logs how fast it went.
+static int ReplayLog(
+    const InputLog& log,
+    bool isPreparingRender,
+    const char* metricsPath)
+{
+    TestHandler handler(log.seed);
+    if (metricsPath && !handler.WriteMetricsTo(metricsPath)) return 1;
+
+    auto seconds = double(handler.Replay(log, isPreparingRender)) /
+        double(SDL_GetPerformanceFrequency());
+
+    Log() << log.tickCount << " ticks with " << log.events.size()
+        << " events" << (isPreparingRender ? " and meshing" : "")
+        << " in " << (seconds * 1000.0) << " ms ("
+        << (seconds > 0.0 ? double(log.tickCount) / seconds : 0.0)
+        << " ticks per second, seed " << log.seed << ")\n"
+        << "Peak memory " << (double(PeakMemoryBytes()) / 1048576.0)
+        << " MiB\n"
+        << "Grid checksum " << hex << Checksum(handler.World()) << dec
+        << '\n';
+
+    return 0;
+}
+
+int RunReplay(const char* path, const char* metricsPath)
+{
+    InputLog log;
+    if (!LoadInputLog(path, log)) return 1;
+
+    return ReplayLog(log, false, metricsPath);
+}
+
+int RunSimulation(const SimulationOptions& options)
+{
+    InputLog log;
+    log.seed = options.seed;
+    log.width = options.displaySize.x;
+    log.height = options.displaySize.y;
+    log.tickCount = options.tickCount;
+
+    // Pan back and forth, turning every PanTicks, so a prepared view keeps
+    // crossing tile boundaries and has to be remeshed.
+    constexpr uint64_t PanTicks = 256;
+    const SDL_Keycode keys[] = {SDLK_d, SDLK_a};
+
+    for (uint64_t tick = 0; tick < log.tickCount; tick += PanTicks)
+    {
+        int turn = int(tick / PanTicks % 2);
+        InputLogEvent event;
+        memset(&event, 0, sizeof(event));
+        event.tick = tick;
+
+        if (tick)
+        {
+            event.event.type = SDL_KEYUP;
+            event.event.key.keysym.sym = keys[1 - turn];
+            log.events.push_back(event);
+        }
+
+        event.event.type = SDL_KEYDOWN;
+        event.event.key.keysym.sym = keys[turn];
+        log.events.push_back(event);
+    }
+
+    return ReplayLog(log, options.isPreparingRender, options.metricsPath);
+}
@@ -0,0 +1,45 @@
+#ifndef Headless_hpp
+#define Headless_hpp
+
+#include "Point.hpp"
+#include <cstdint>
+
+struct HeadlessOptions
+{
+    Point<int> displaySize = {1024, 768};
+    int frameCount = 600;
+    uint32_t seed = 1;
+
+    /// When set, every dumpInterval-th frame is written to
+    /// <dumpPrefix><frame>.ppm for golden image comparison.
+    const char* dumpPrefix = nullptr;
+    int dumpInterval = 60;
+};
+
+/// Renders a scripted camera path over a seeded world into an offscreen
+/// EGL pbuffer, with no window or display server, and logs per-frame CPU
+/// time spent preparing and submitting. Returns a process exit code.
+int RunHeadless(const HeadlessOptions& options);
+
+struct SimulationOptions
+{
+    Point<int> displaySize = {1024, 768};
+    uint64_t tickCount = 36000;
+    uint32_t seed = 1;
+    bool isPreparingRender = false;
+
+    /// When set, metrics are snapshotted here every virtual second.
+    const char* metricsPath = nullptr;
+};
+
+/// Replays an input log recorded with --record as fast as possible, then
+/// logs ticks per second, peak memory and a checksum of the final Grid.
+/// When metricsPath is set, metrics are snapshotted there every virtual
+/// second. Needs no window or GL. Returns a process exit code.
+int RunReplay(const char* path, const char* metricsPath);
+
+/// Steps a seeded world through tickCount updates on a virtual clock, with
+/// a scripted pan, and reports like RunReplay. Needs no window or GL.
+int RunSimulation(const SimulationOptions& options);
+
+#endif
@@ -0,0 +1,60 @@
+#include "Histogram.hpp"
+#include "Math.hpp"
+#include <cstring>
+using namespace std;
+
+int Histogram::BucketOf(uint64_t value)
+{
+    // Small values get a bucket each; above that, the top bit picks the
+    // power of two and the next SubBucketBits bits the slice within it.
+    if (value < SubBucketCount) return int(value);
+
+    int topBit = 63 - __builtin_clzll(value);
+    int shift = topBit - SubBucketBits;
+    return ((shift + 1) << SubBucketBits) +
+        int((value >> shift) & (SubBucketCount - 1));
+}
+
+uint64_t Histogram::UpperBound(int bucket)
+{
+    if (bucket < SubBucketCount) return uint64_t(bucket);
+
+    int shift = (bucket >> SubBucketBits) - 1;
+    uint64_t slice = uint64_t(SubBucketCount | (bucket & (SubBucketCount - 1)));
+    return ((slice + 1) << shift) - 1;
+}
+
+uint64_t Histogram::Percentile(double fraction) const
+{
+    if (!_count) return 0;
+
+    auto target = uint64_t(fraction * double(_count) + 0.5);
+    if (target < 1) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; ++i)
+    {
+        seen += _buckets[i];
+        if (seen >= target) return Min(UpperBound(i), _max);
+    }
+
+    return _max;
+}
+
+void Histogram::Add(const uint32_t* buckets, uint64_t max)
+{
+    for (int i = 0; i < BucketCount; ++i)
+    {
+        _buckets[i] += buckets[i];
+        _count += buckets[i];
+    }
+
+    if (max > _max) _max = max;
+}
+
+void Histogram::Reset()
+{
+    memset(_buckets, 0, sizeof(_buckets));
+    _count = 0;
+    _max = 0;
+}
@@ -0,0 +1,48 @@
+#ifndef Histogram_hpp
+#define Histogram_hpp
+
+#include <cstdint>
+
+/// Fixed-bucket histogram of nanosecond durations. Buckets are log-linear:
+/// each power of two is split into eight, so any percentile is within
+/// 12.5% of the true value. Recording is a few instructions and never
+/// allocates.
+class Histogram
+{
+public:
+    static constexpr int SubBucketBits = 3;
+    static constexpr int SubBucketCount = 1 << SubBucketBits;
+    static constexpr int BucketCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+private:
+    uint32_t _buckets[BucketCount] = {};
+    uint32_t _count = 0;
+    uint64_t _max = 0;
+
+    static uint64_t UpperBound(int bucket);
+
+public:
+    static int BucketOf(uint64_t value);
+
+    inline void Record(uint64_t nanoseconds)
+    {
+        ++_buckets[BucketOf(nanoseconds)];
+        ++_count;
+        if (nanoseconds > _max) _max = nanoseconds;
+    }
+
+    inline uint32_t Count() const { return _count; }
+    inline uint64_t Max() const { return _max; }
+
+    /// Smallest bucket bound that at least fraction of the samples fall
+    /// under, capped at the largest sample. Zero when empty.
+    uint64_t Percentile(double fraction) const;
+
+    /// Adds samples counted elsewhere with the same layout, one count per
+    /// bucket, as when merging shards.
+    void Add(const uint32_t* buckets, uint64_t max);
+
+    void Reset();
+};
+
+#endif
@@ -0,0 +1,57 @@
+#include "Image.hpp"
+#include "Debug.hpp"
+#include <SDL_image.h>
+#include <cstring>
+using namespace std;
+
+static constexpr auto PixelFormat = SDL_PIXELFORMAT_ABGR8888;
+
+Image LoadImage(const char* path)
+{
+    Image result;
+    auto surface = IMG_Load(path);
+
+    if (surface)
+    {
+        if (surface->format->format != PixelFormat)
+        {
+            LOG_DEBUG << "Converting format for " << path << '\n';
+            auto convertedSurface = SDL_ConvertSurfaceFormat(
+                surface,
+                PixelFormat,
+                0);
+
+            SDL_FreeSurface(surface);
+            surface = convertedSurface;
+        }
+
+        if (surface)
+        {
+            LOG_DEBUG << "Loaded " << path << " successfully!\n";
+            result.width = surface->w;
+            result.height = surface->h;
+            result.pixels.resize(result.width * result.height);
+
+            auto source = static_cast<const uint8_t*>(surface->pixels);
+            for (int i = 0; i < result.height; ++i)
+            {
+                memcpy(
+                    &result.pixels[i * result.width],
+                    source + i * surface->pitch,
+                    result.width * sizeof(uint32_t));
+            }
+        }
+        else
+        {
+            LOG_ERROR << "Failed to convert image format for " << path << '\n';
+        }
+
+        SDL_FreeSurface(surface);
+    }
+    else
+    {
+        LOG_ERROR << "Failed to load image " << path << '\n';
+    }
+
+    return result;
+}
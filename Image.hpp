@@ -0,0 +1,29 @@
+#ifndef Image_hpp
+#define Image_hpp
+
+#include <vector>
+#include <cstdint>
+
+/// Tightly packed ABGR8888 pixels, which is RGBA byte order on little
+/// endian machines and can go straight to glTexImage2D.
+struct Image
+{
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> pixels;
+
+    inline uint32_t& operator()(int x, int y)
+    {
+        return pixels[y * width + x];
+    }
+
+    inline uint32_t operator()(int x, int y) const
+    {
+        return pixels[y * width + x];
+    }
+};
+
+/// Returns an empty image on failure.
+Image LoadImage(const char* path);
+
+#endif
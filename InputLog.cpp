@@ -0,0 +1,159 @@
+#include "InputLog.hpp"
+#include "Debug.hpp"
+#include <cstring>
+#include <iterator>
+using namespace std;
+
+static const char InputLogMagic[4] = {'K', 'R', 'I', 'R'};
+
+/// Bytes of the event worth keeping, or zero to drop it.
+static uint8_t RecordedSize(const SDL_Event& event)
+{
+    switch (event.type)
+    {
+        case SDL_WINDOWEVENT: return sizeof(SDL_WindowEvent);
+        case SDL_KEYDOWN:
+        case SDL_KEYUP: return sizeof(SDL_KeyboardEvent);
+        case SDL_MOUSEMOTION: return sizeof(SDL_MouseMotionEvent);
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP: return sizeof(SDL_MouseButtonEvent);
+        case SDL_MOUSEWHEEL: return sizeof(SDL_MouseWheelEvent);
+        case SDL_JOYAXISMOTION: return sizeof(SDL_JoyAxisEvent);
+        case SDL_JOYBALLMOTION: return sizeof(SDL_JoyBallEvent);
+        case SDL_JOYHATMOTION: return sizeof(SDL_JoyHatEvent);
+        case SDL_JOYBUTTONDOWN:
+        case SDL_JOYBUTTONUP: return sizeof(SDL_JoyButtonEvent);
+        case SDL_CONTROLLERAXISMOTION: return sizeof(SDL_ControllerAxisEvent);
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP: return sizeof(SDL_ControllerButtonEvent);
+        case SDL_QUIT: return sizeof(SDL_QuitEvent);
+        default: return 0;
+    }
+}
+
+bool InputRecorder::Open(
+    const char* path,
+    uint32_t seed,
+    int32_t width,
+    int32_t height)
+{
+    _stream.open(path, ofstream::binary);
+    if (!_stream)
+    {
+        LOG_ERROR << "Failed to open " << path << " for recording\n";
+        return false;
+    }
+
+    InputLogHeader header;
+    memcpy(header.magic, InputLogMagic, sizeof(header.magic));
+    header.version = InputLogVersion;
+    header.seed = seed;
+    header.width = width;
+    header.height = height;
+    _stream.write((const char*)&header, sizeof(header));
+    _tick = 0;
+    return true;
+}
+
+void InputRecorder::WriteRecord(uint64_t tick, const void* data, uint8_t size)
+{
+    uint8_t bytes[10];
+    int count = 0;
+
+    for (auto delta = tick - _tick; ; delta >>= 7)
+    {
+        bytes[count++] = uint8_t(delta & 0x7f) | (delta > 0x7f ? 0x80 : 0);
+        if (delta <= 0x7f) break;
+    }
+
+    bytes[count++] = size;
+    _stream.write((const char*)bytes, count);
+    _stream.write((const char*)data, size);
+    _tick = tick;
+}
+
+void InputRecorder::Add(uint64_t tick, const SDL_Event& event)
+{
+    if (!_stream.is_open()) return;
+
+    auto size = RecordedSize(event);
+    if (size) WriteRecord(tick, &event, size);
+}
+
+void InputRecorder::Close(uint64_t tickCount)
+{
+    if (!_stream.is_open()) return;
+
+    WriteRecord(tickCount, nullptr, 0);
+    _stream.close();
+}
+
+bool LoadInputLog(const char* path, InputLog& log)
+{
+    ifstream stream(path, ifstream::binary);
+    vector<uint8_t> data(
+        (istreambuf_iterator<char>(stream)),
+        istreambuf_iterator<char>());
+
+    InputLogHeader header;
+    if (data.size() < sizeof(header))
+    {
+        LOG_ERROR << path << " is not an input log\n";
+        return false;
+    }
+
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, InputLogMagic, sizeof(header.magic)) ||
+        header.version != InputLogVersion)
+    {
+        LOG_ERROR << path << " is not a version " << InputLogVersion
+            << " input log\n";
+        return false;
+    }
+
+    log = InputLog();
+    log.seed = header.seed;
+    log.width = header.width;
+    log.height = header.height;
+
+    size_t offset = sizeof(header);
+    uint64_t tick = 0;
+
+    while (offset < data.size())
+    {
+        uint64_t delta = 0;
+        int shift = 0;
+        while (offset < data.size() && shift < 64)
+        {
+            auto byte = data[offset++];
+            delta |= uint64_t(byte & 0x7f) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) break;
+        }
+
+        if (offset >= data.size()) break;
+        uint8_t size = data[offset++];
+        if (size > sizeof(SDL_Event) || data.size() - offset < size) break;
+
+        tick += delta;
+
+        if (!size)
+        {
+            log.tickCount = tick;
+            return true;
+        }
+
+        InputLogEvent event;
+        event.tick = tick;
+        memset(&event.event, 0, sizeof(event.event));
+        memcpy(&event.event, data.data() + offset, size);
+        log.events.push_back(event);
+        offset += size;
+    }
+
+    // Cut short, most likely by a crash. Keep what made it to disk.
+    log.tickCount = tick;
+    LOG_WARNING << path << " has no end record; replaying to tick " << tick
+        << '\n';
+    return true;
+}
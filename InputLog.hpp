@@ -0,0 +1,61 @@
+#ifndef InputLog_hpp
+#define InputLog_hpp
+
+#include <SDL.h>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+/// An input log is an InputLogHeader followed by one record per event:
+/// the update ticks since the previous record as a varint, a byte giving
+/// the event's size, then that prefix of the SDL_Event. A record of size
+/// zero ends the log at the tick it names. Events are stored in native
+/// layout; replay on the platform that recorded.
+constexpr uint32_t InputLogVersion = 1;
+
+struct InputLogHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t seed;
+    int32_t width; // Window size when the recording started.
+    int32_t height;
+};
+
+struct InputLogEvent
+{
+    uint64_t tick; // Updates completed before the event was handled.
+    SDL_Event event;
+};
+
+struct InputLog
+{
+    uint32_t seed = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<InputLogEvent> events;
+    uint64_t tickCount = 0;
+};
+
+class InputRecorder
+{
+    std::ofstream _stream;
+    uint64_t _tick = 0;
+
+    void WriteRecord(uint64_t tick, const void* data, uint8_t size);
+
+public:
+    bool Open(const char* path, uint32_t seed, int32_t width, int32_t height);
+
+    /// Events that carry pointers, or that nothing handles, are dropped.
+    void Add(uint64_t tick, const SDL_Event& event);
+
+    /// Writes the end record. Without it the log still loads, ending at
+    /// its last event.
+    void Close(uint64_t tickCount);
+};
+
+/// Returns false if the file is missing or not an input log.
+bool LoadInputLog(const char* path, InputLog& log);
+
+#endif
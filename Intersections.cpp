@@ -0,0 +1,312 @@
+#include "Intersections.hpp"
+#include "Debug.hpp"
+#include <algorithm>
+#include <queue>
+#include <set>
+using namespace std;
+
+/// Sign of a * b - c * d, exact for any 64-bit terms.
+static inline int SignOfDifference(int64_t a, int64_t b, int64_t c, int64_t d)
+{
+    auto left = WideProduct(a, b);
+    auto right = WideProduct(c, d);
+    return left < right ? -1 : right < left ? 1 : 0;
+}
+
+/// Which side of line o-a point b is on: 1 left, -1 right, 0 on it.
+static inline int Orientation(Point64 o, Point64 a, Point64 b)
+{
+    return SignOfDifference(a.x - o.x, b.y - o.y, a.y - o.y, b.x - o.x);
+}
+
+/// For collinear b: whether it lies within the box of a-c.
+static inline bool IsWithin(Point64 a, Point64 b, Point64 c)
+{
+    return Min(a.x, c.x) <= b.x && b.x <= Max(a.x, c.x) &&
+        Min(a.y, c.y) <= b.y && b.y <= Max(a.y, c.y);
+}
+
+bool SegmentsIntersect(LineSegment32 a, LineSegment32 b)
+{
+    auto a1 = a.p1.Cast<int64_t>();
+    auto a2 = a.p2.Cast<int64_t>();
+    auto b1 = b.p1.Cast<int64_t>();
+    auto b2 = b.p2.Cast<int64_t>();
+
+    int o1 = Orientation(a1, a2, b1);
+    int o2 = Orientation(a1, a2, b2);
+    int o3 = Orientation(b1, b2, a1);
+    int o4 = Orientation(b1, b2, a2);
+
+    if (o1 * o2 < 0 && o3 * o4 < 0) return true;
+
+    return (!o1 && IsWithin(a1, b1, a2)) ||
+        (!o2 && IsWithin(a1, b2, a2)) ||
+        (!o3 && IsWithin(b1, a1, b2)) ||
+        (!o4 && IsWithin(b1, a2, b2));
+}
+
+/// (x / d, y / d) with d > 0: an endpoint, or where two segments cross.
+struct EventPoint
+{
+    int64_t x;
+    int64_t y;
+    int64_t d;
+};
+
+/// Sweep order: by x, then by y, so a vertical segment is swept upward.
+static inline bool IsBefore(const EventPoint& p, const EventPoint& q)
+{
+    int order = Compare(Rational64{p.x, p.d}, Rational64{q.x, q.d});
+    if (order) return order < 0;
+    return Rational64{p.y, p.d} < Rational64{q.y, q.d};
+}
+
+static inline bool IsSame(const EventPoint& p, const EventPoint& q)
+{
+    return !IsBefore(p, q) && !IsBefore(q, p);
+}
+
+static inline EventPoint ToEvent(Point64 p)
+{
+    return {p.x, p.y, 1};
+}
+
+/// A segment with low before high in sweep order.
+struct SweepSegment
+{
+    Point64 low;
+    Point64 high;
+    Point64 delta;
+};
+
+/// Which side of s point p is on: 1 above, -1 below, 0 on its line. A
+/// vertical segment in the status always passes through the sweep point,
+/// so it only ever gives 0.
+static inline int Orientation(const SweepSegment& s, const EventPoint& p)
+{
+    return SignOfDifference(
+        s.delta.x, p.y - s.low.y * p.d,
+        s.delta.y, p.x - s.low.x * p.d);
+}
+
+/// Where a and b cross, if they do at a single point.
+static bool FindCrossing(
+    const SweepSegment& a,
+    const SweepSegment& b,
+    EventPoint& crossing)
+{
+    auto d = CrossZ(a.delta, b.delta);
+    if (!d) return false;
+
+    auto offset = b.low - a.low;
+    auto t = CrossZ(offset, b.delta);
+    auto u = CrossZ(offset, a.delta);
+
+    if (d < 0) d = -d, t = -t, u = -u;
+    if (t < 0 || t > d || u < 0 || u > d) return false;
+
+    crossing = {
+        a.low.x * d + t * a.delta.x,
+        a.low.y * d + t * a.delta.y,
+        d};
+    return true;
+}
+
+struct SweepState
+{
+    vector<SweepSegment> segments;
+    EventPoint point;
+
+    /// Marks the segments being inserted at point, which all pass through
+    /// it. Everything else in the status is strictly above or below it.
+    vector<char> isAtPoint;
+};
+
+/// Bottom to top along the sweep line just after the current point.
+struct StatusOrder
+{
+    typedef void is_transparent;
+
+    const SweepState* state;
+
+    bool operator()(int a, int b) const
+    {
+        const auto& sa = state->segments[a];
+        const auto& sb = state->segments[b];
+        bool isAAtPoint = state->isAtPoint[a];
+        bool isBAtPoint = state->isAtPoint[b];
+
+        if (isAAtPoint && isBAtPoint)
+        {
+            // Both leave the point: the shallower slope is below, and a
+            // vertical segment is above everything.
+            bool isAVertical = !sa.delta.x;
+            bool isBVertical = !sb.delta.x;
+            if (isAVertical != isBVertical) return isBVertical;
+
+            auto turn = CrossZ(sa.delta, sb.delta);
+            if (turn) return turn > 0;
+            return a < b;
+        }
+
+        if (isAAtPoint) return Orientation(sb, state->point) < 0;
+        if (isBAtPoint) return Orientation(sa, state->point) > 0;
+
+        // Segments already in place are never compared with each other.
+        return a < b;
+    }
+
+    bool operator()(int a, const EventPoint& p) const
+    {
+        return Orientation(state->segments[a], p) > 0;
+    }
+
+    bool operator()(const EventPoint& p, int b) const
+    {
+        return Orientation(state->segments[b], p) < 0;
+    }
+};
+
+struct IsLater
+{
+    bool operator()(const EventPoint& p, const EventPoint& q) const
+    {
+        return IsBefore(q, p);
+    }
+};
+
+bool FindIntersections(
+    Span<const LineSegment32> segments,
+    vector<pair<int, int>>& pairs)
+{
+    pairs.clear();
+
+    SweepState state;
+    state.segments.reserve(segments.count);
+    state.isAtPoint.assign(segments.count, 0);
+
+    // Every endpoint is an event; an endpoint that starts a segment
+    // carries its index.
+    vector<pair<EventPoint, int>> endpoints;
+    endpoints.reserve(segments.count * 2);
+
+    for (int i = 0; i < segments.count; ++i)
+    {
+        auto p1 = segments.data[i].p1.Cast<int64_t>();
+        auto p2 = segments.data[i].p2.Cast<int64_t>();
+
+        auto extent = Max(
+            Max(Magnitude(p1.x), Magnitude(p1.y)),
+            Max(Magnitude(p2.x), Magnitude(p2.y)));
+
+        if (extent > uint64_t(MaxSweepCoordinate))
+        {
+            LOG_ERROR << "Segment " << segments.data[i]
+                << " is outside the intersection sweep's range\n";
+            return false;
+        }
+
+        if (IsBefore(ToEvent(p2), ToEvent(p1))) swap(p1, p2);
+
+        state.segments.push_back({p1, p2, p2 - p1});
+        endpoints.emplace_back(ToEvent(p1), i);
+        endpoints.emplace_back(ToEvent(p2), -1);
+    }
+
+    sort(endpoints.begin(), endpoints.end(),
+        [](const pair<EventPoint, int>& a, const pair<EventPoint, int>& b)
+        {
+            return IsBefore(a.first, b.first);
+        });
+
+    priority_queue<EventPoint, vector<EventPoint>, IsLater> crossings;
+    set<int, StatusOrder> status(StatusOrder{&state});
+    vector<int> atPoint;
+    size_t nextEndpoint = 0;
+
+    auto addCrossing = [&](int a, int b)
+    {
+        EventPoint crossing;
+        if (FindCrossing(state.segments[a], state.segments[b], crossing) &&
+            IsBefore(state.point, crossing))
+        {
+            crossings.push(crossing);
+        }
+    };
+
+    while (nextEndpoint < endpoints.size() || !crossings.empty())
+    {
+        auto& point = state.point;
+        if (nextEndpoint == endpoints.size() ||
+            (!crossings.empty() &&
+                IsBefore(crossings.top(), endpoints[nextEndpoint].first)))
+        {
+            point = crossings.top();
+        }
+        else
+        {
+            point = endpoints[nextEndpoint].first;
+        }
+
+        while (!crossings.empty() && IsSame(crossings.top(), point))
+            crossings.pop();
+
+        // Segments starting here, then those in the status through here,
+        // which are contiguous in it.
+        atPoint.clear();
+        for (; nextEndpoint < endpoints.size() &&
+            IsSame(endpoints[nextEndpoint].first, point); ++nextEndpoint)
+        {
+            if (endpoints[nextEndpoint].second >= 0)
+                atPoint.push_back(endpoints[nextEndpoint].second);
+        }
+
+        auto startCount = atPoint.size();
+        auto first = status.lower_bound(point);
+        auto last = status.upper_bound(point);
+        atPoint.insert(atPoint.end(), first, last);
+        status.erase(first, last);
+
+        for (size_t i = 0; i < atPoint.size(); ++i)
+        {
+            for (size_t j = i + 1; j < atPoint.size(); ++j)
+                pairs.push_back(minmax(atPoint[i], atPoint[j]));
+        }
+
+        // Put back everything that continues past here, in its order just
+        // after the point.
+        for (size_t i = 0; i < atPoint.size(); ++i)
+        {
+            int index = atPoint[i];
+            const auto& segment = state.segments[index];
+            if (i >= startCount &&
+                IsSame(ToEvent(segment.high), point)) continue;
+            if (!segment.delta.x && !segment.delta.y) continue;
+
+            state.isAtPoint[index] = 1;
+            status.insert(index);
+        }
+
+        for (auto index : atPoint) state.isAtPoint[index] = 0;
+
+        // Only segments that just became neighbours can cross next.
+        first = status.lower_bound(point);
+        last = status.upper_bound(point);
+
+        if (first == last)
+        {
+            if (first != status.begin() && last != status.end())
+                addCrossing(*prev(first), *last);
+        }
+        else
+        {
+            if (first != status.begin()) addCrossing(*prev(first), *first);
+            if (last != status.end()) addCrossing(*prev(last), *last);
+        }
+    }
+
+    sort(pairs.begin(), pairs.end());
+    pairs.erase(unique(pairs.begin(), pairs.end()), pairs.end());
+    return true;
+}
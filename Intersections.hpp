@@ -0,0 +1,29 @@
+#ifndef Intersections_hpp
+#define Intersections_hpp
+
+#include "LineSegment.hpp"
+#include "Span.hpp"
+#include <utility>
+#include <vector>
+
+/// Intersection of whole sets of segments, such as collision outlines or
+/// light occluders. Segments are closed: touching at an endpoint, or
+/// overlapping along a shared line, counts as intersecting.
+
+/// Largest coordinate magnitude the sweep accepts. Within it every
+/// predicate, including ordering intersection points, is exact in 64-bit
+/// terms with 128-bit products.
+constexpr int32_t MaxSweepCoordinate = 1 << 19;
+
+/// Exact test for one pair, by orientation (CrossZ) alone.
+bool SegmentsIntersect(LineSegment32 a, LineSegment32 b);
+
+/// Sets pairs to every (i, j), i < j, of segments that intersect, sorted.
+/// A Bentley-Ottmann sweep: O((n + k) log n) for k intersections, where
+/// testing all pairs is O(n^2). Returns false if a coordinate is out of
+/// range.
+bool FindIntersections(
+    Span<const LineSegment32> segments,
+    std::vector<std::pair<int, int>>& pairs);
+
+#endif
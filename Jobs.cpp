@@ -0,0 +1,128 @@
+#include "Jobs.hpp"
+#include "Profile.hpp"
+using namespace std;
+
+// Which pool, if any, the current thread works for, and its queue there.
+static thread_local const JobSystem* theCurrentSystem = nullptr;
+static thread_local int theWorkerIndex = -1;
+
+JobSystem::JobSystem(int workerCount)
+{
+    workerCount = Max(workerCount, 0);
+
+    // The last queue belongs to threads outside the pool.
+    for (int i = 0; i <= workerCount; ++i)
+        _queues.push_back(unique_ptr<Queue>(new Queue));
+
+    for (int i = 0; i < workerCount; ++i)
+        _workers.push_back(thread(&JobSystem::WorkerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        lock_guard<mutex> lock(_sleepMutex);
+        _stopping = true;
+    }
+
+    _wake.notify_all();
+    for (auto& worker : _workers) worker.join();
+}
+
+int JobSystem::DefaultWorkerCount()
+{
+    return Max(int(thread::hardware_concurrency()) - 1, 0);
+}
+
+int JobSystem::QueueIndex() const
+{
+    return theCurrentSystem == this ? theWorkerIndex : int(_workers.size());
+}
+
+void JobSystem::Run(TaskGroup& group, function<void()> task)
+{
+    group._pending.fetch_add(1, memory_order_relaxed);
+
+    {
+        auto& queue = *_queues[QueueIndex()];
+        lock_guard<mutex> lock(queue.mutex);
+        queue.tasks.push_back({move(task), &group});
+    }
+
+    // Counting under the sleep lock means a worker that just found
+    // nothing cannot miss this wake-up.
+    {
+        lock_guard<mutex> lock(_sleepMutex);
+        _queuedCount.fetch_add(1, memory_order_relaxed);
+    }
+
+    _wake.notify_one();
+}
+
+/// Runs one task: the newest from the home queue, else the oldest from
+/// another. Returns false if every queue was empty.
+bool JobSystem::TryRun(int home)
+{
+    Task task;
+    bool found = false;
+    int queueCount = int(_queues.size());
+
+    for (int i = 0; i < queueCount && !found; ++i)
+    {
+        auto& queue = *_queues[(home + i) % queueCount];
+        lock_guard<mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        if (i == 0)
+        {
+            task = move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+
+        found = true;
+    }
+
+    if (!found) return false;
+
+    _queuedCount.fetch_sub(1, memory_order_relaxed);
+    task.run();
+    task.group->_pending.fetch_sub(1, memory_order_release);
+    return true;
+}
+
+void JobSystem::Wait(TaskGroup& group)
+{
+    int home = QueueIndex();
+
+    while (!group.IsDone())
+    {
+        // The remaining tasks may be running elsewhere; give way to them
+        // rather than spin.
+        if (!TryRun(home)) this_thread::yield();
+    }
+}
+
+void JobSystem::WorkerLoop(int index)
+{
+    theCurrentSystem = this;
+    theWorkerIndex = index;
+    PROFILE_THREAD("worker");
+
+    while (true)
+    {
+        if (TryRun(index)) continue;
+
+        unique_lock<mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this]
+        {
+            return _stopping || _queuedCount.load(memory_order_relaxed) > 0;
+        });
+
+        if (_stopping && !_queuedCount.load(memory_order_relaxed)) break;
+    }
+}
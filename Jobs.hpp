@@ -0,0 +1,102 @@
+#ifndef Jobs_hpp
+#define Jobs_hpp
+
+#include "Math.hpp"
+#include "Span.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Counts the unfinished tasks of one fork/join. Pass it to
+/// JobSystem::Wait to join.
+class TaskGroup
+{
+    friend class JobSystem;
+    std::atomic<int> _pending{0};
+
+public:
+    inline bool IsDone() const
+    {
+        return _pending.load(std::memory_order_acquire) == 0;
+    }
+};
+
+/// Work-stealing thread pool. Every worker owns a queue: it pushes and
+/// pops at the back, and idle workers steal from the front of the others.
+/// Threads outside the pool share one extra queue, and help run tasks
+/// while they wait on a group.
+class JobSystem
+{
+    struct Task
+    {
+        std::function<void()> run;
+        TaskGroup* group;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+    std::atomic<int> _queuedCount{0};
+    bool _stopping = false;
+
+    int QueueIndex() const;
+    bool TryRun(int home);
+    void WorkerLoop(int index);
+
+public:
+    /// Zero workers is valid: tasks then run inside Wait.
+    explicit JobSystem(int workerCount = DefaultWorkerCount());
+    JobSystem(JobSystem&&) = delete;
+    JobSystem(const JobSystem&) = delete;
+    ~JobSystem();
+
+    JobSystem& operator=(JobSystem&&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /// One per core, less the thread that hands out the work.
+    static int DefaultWorkerCount();
+
+    inline int WorkerCount() const { return int(_workers.size()); }
+
+    /// Queues task as part of group. Tasks may queue further tasks.
+    void Run(TaskGroup& group, std::function<void()> task);
+
+    /// Runs queued tasks, from any group, until group is done.
+    void Wait(TaskGroup& group);
+
+    /// Calls f(part, majorStart) on slices of span along its major axis,
+    /// grain majors at a time, and returns once every slice is done.
+    template<typename T, typename F> void ParallelFor(
+        Span2D<T> span,
+        int grain,
+        F&& f)
+    {
+        TaskGroup group;
+        grain = Max(grain, 1);
+
+        for (int start = 0; start < span.major; start += grain)
+        {
+            Span2D<T> part = {
+                span.data + start * span.minor,
+                Min(grain, span.major - start),
+                span.minor};
+            Run(group, [part, start, &f] { f(part, start); });
+        }
+
+        Wait(group);
+    }
+};
+
+#endif
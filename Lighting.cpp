@@ -0,0 +1,183 @@
+#include "Lighting.hpp"
+using namespace std;
+
+/// Light lost per tile crossed.
+static constexpr uint8_t AirFalloff = 1;
+static constexpr uint8_t SolidFalloff = 3;
+
+static inline uint8_t Attenuated(uint8_t level, uint16_t tile)
+{
+    uint8_t falloff = tile == NoTile ? AirFalloff : SolidFalloff;
+    return level > falloff ? level - falloff : 0;
+}
+
+/// Calls f(neighborIndex, isBelow) for each in-bounds neighbor.
+template<typename F> static inline void ForEachNeighbor(
+    Point<int> size,
+    int index,
+    F&& f)
+{
+    int y = index % size.y;
+    if (y > 0) f(index - 1, true);
+    if (y + 1 < size.y) f(index + 1, false);
+    if (index >= size.y) f(index - size.y, false);
+    if (index + size.y < size.x * size.y) f(index + size.y, false);
+}
+
+uint8_t LightField::Emission(uint16_t tile) const
+{
+    return tile < _emission.size() ? _emission[tile] : 0;
+}
+
+void LightField::SetEmission(vector<uint8_t> emission)
+{
+    _emission = move(emission);
+}
+
+/// Breadth-first fill from everything in _spreadQueue.
+void LightField::Spread(const Grid& grid, vector<uint8_t>& light, bool isSky)
+{
+    for (size_t head = 0; head < _spreadQueue.size(); ++head)
+    {
+        int index = _spreadQueue[head];
+        uint8_t level = light[index];
+        if (level < 2) continue;
+
+        ForEachNeighbor(_size, index, [&](int neighbor, bool isBelow)
+        {
+            auto tile = grid.tiles[neighbor];
+            uint8_t next = isSky && isBelow && level == MaxLight &&
+                tile == NoTile ? MaxLight : Attenuated(level, tile);
+
+            if (next > light[neighbor])
+            {
+                light[neighbor] = next;
+                _spreadQueue.push_back(neighbor);
+            }
+        });
+    }
+
+    _spreadQueue.clear();
+}
+
+void LightField::Compute(const Grid& grid)
+{
+    _size = grid.size;
+    int count = _size.x * _size.y;
+    _sky.assign(count, 0);
+    _glow.assign(count, 0);
+    _spreadQueue.clear();
+
+    // Open sky: every air tile above the first solid one in its column.
+    for (int x = 0; x < _size.x; ++x)
+    {
+        int column = x * _size.y;
+        for (int y = _size.y - 1; y >= 0; --y)
+        {
+            if (grid.tiles[column + y] != NoTile) break;
+            _sky[column + y] = MaxLight;
+        }
+    }
+
+    // Only open sky bordering something darker has anywhere to spread.
+    for (int index = 0; index < count; ++index)
+    {
+        if (_sky[index] != MaxLight) continue;
+
+        bool isEdge = false;
+        ForEachNeighbor(_size, index, [&](int neighbor, bool)
+        {
+            isEdge = isEdge || _sky[neighbor] != MaxLight;
+        });
+
+        if (isEdge) _spreadQueue.push_back(index);
+    }
+
+    Spread(grid, _sky, true);
+
+    for (int index = 0; index < count; ++index)
+    {
+        auto emission = Emission(grid.tiles[index]);
+        if (!emission) continue;
+
+        _glow[index] = emission;
+        _spreadQueue.push_back(index);
+    }
+
+    Spread(grid, _glow, false);
+    ++_revision;
+}
+
+/// Darkens everything that may have been lit through index, remembering
+/// the brighter cells bordering that region, then floods back in from them.
+void LightField::Relight(
+    const Grid& grid,
+    vector<uint8_t>& light,
+    bool isSky,
+    int index,
+    uint8_t source)
+{
+    _removeQueue.clear();
+    _removeQueue.push_back({index, light[index]});
+    light[index] = 0;
+
+    for (size_t head = 0; head < _removeQueue.size(); ++head)
+    {
+        auto node = _removeQueue[head];
+
+        ForEachNeighbor(_size, node.index, [&](int neighbor, bool isBelow)
+        {
+            uint8_t level = light[neighbor];
+            if (!level) return;
+
+            bool isDependent = level < node.level ||
+                (isSky && isBelow && node.level == MaxLight &&
+                    level == MaxLight);
+
+            if (!isDependent)
+            {
+                _spreadQueue.push_back(neighbor);
+                return;
+            }
+
+            light[neighbor] = 0;
+            _removeQueue.push_back({neighbor, level});
+
+            // Emitters caught in the dark region still shine on their own.
+            auto emission = isSky ? 0 : Emission(grid.tiles[neighbor]);
+            if (emission)
+            {
+                light[neighbor] = emission;
+                _spreadQueue.push_back(neighbor);
+            }
+        });
+    }
+
+    if (source > light[index])
+    {
+        light[index] = source;
+        _spreadQueue.push_back(index);
+    }
+
+    Spread(grid, light, isSky);
+}
+
+void LightField::Update(const Grid& grid, Point<int> position)
+{
+    if (grid.size != _size)
+    {
+        Compute(grid);
+        return;
+    }
+
+    int index = position.x * _size.y + position.y;
+    auto tile = grid.tiles[index];
+
+    // Only the top row sees the sky directly; lower air tiles get it from
+    // the tile above during the refill.
+    uint8_t sky = tile == NoTile && position.y == _size.y - 1 ? MaxLight : 0;
+
+    Relight(grid, _sky, true, index, sky);
+    Relight(grid, _glow, false, index, Emission(tile));
+    ++_revision;
+}
@@ -0,0 +1,65 @@
+#ifndef Lighting_hpp
+#define Lighting_hpp
+
+#include "Grid.hpp"
+#include <vector>
+#include <cstdint>
+
+constexpr uint8_t MaxLight = 15;
+
+/// Per-tile light levels from 0 to MaxLight in two channels. Sky light
+/// falls straight down through open air without fading, then spreads like
+/// any other light. Glow comes from emissive tiles. Both spread by
+/// breadth-first flood fill, losing a little per open tile and a lot per
+/// solid one.
+///
+/// After a tile changes, Update only clears and refills the cells whose
+/// light could have come through that tile, rather than relighting the
+/// whole grid.
+class LightField
+{
+    struct Node
+    {
+        int index;
+        uint8_t level;
+    };
+
+    Point<int> _size = {};
+    std::vector<uint8_t> _sky;
+    std::vector<uint8_t> _glow;
+    std::vector<uint8_t> _emission;
+    std::vector<Node> _removeQueue;
+    std::vector<int> _spreadQueue;
+    uint32_t _revision = 0;
+
+    uint8_t Emission(uint16_t tile) const;
+    void Spread(const Grid& grid, std::vector<uint8_t>& light, bool isSky);
+    void Relight(
+        const Grid& grid,
+        std::vector<uint8_t>& light,
+        bool isSky,
+        int index,
+        uint8_t source);
+
+public:
+    /// Light emitted by each tile ID; IDs past the end emit nothing.
+    void SetEmission(std::vector<uint8_t> emission);
+
+    /// Lights the whole grid from scratch.
+    void Compute(const Grid& grid);
+
+    /// Call after the tile at position changed.
+    void Update(const Grid& grid, Point<int> position);
+
+    inline uint8_t Level(int x, int y) const
+    {
+        int index = x * _size.y + y;
+        return _sky[index] > _glow[index] ? _sky[index] : _glow[index];
+    }
+
+    /// Bumped whenever any level may have changed.
+    inline uint32_t Revision() const { return _revision; }
+    inline Point<int> Size() const { return _size; }
+};
+
+#endif
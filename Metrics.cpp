@@ -0,0 +1,148 @@
+#include "Metrics.hpp"
+#include "Debug.hpp"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+template<typename T> using MetricList = vector<pair<string, unique_ptr<T>>>;
+
+struct MetricRegistry
+{
+    // Guards registration and snapshots; recording never takes it.
+    mutex registryMutex;
+    MetricList<MetricCounter> counters;
+    MetricList<MetricGauge> gauges;
+    MetricList<MetricHistogram> histograms;
+};
+
+/// Built on first use, so other files can register from their own static
+/// initializers.
+static MetricRegistry& TheRegistry()
+{
+    static MetricRegistry registry;
+    return registry;
+}
+
+static atomic<int> theNextShard{0};
+
+int MetricShard()
+{
+    thread_local int shard = theNextShard++ % MetricShardCount;
+    return shard;
+}
+
+int64_t MetricCounter::Value() const
+{
+    int64_t result = 0;
+    for (const auto& shard : _shards)
+        result += shard.value.load(memory_order_relaxed);
+    return result;
+}
+
+void MetricHistogram::Record(uint64_t nanoseconds)
+{
+    auto& shard = _shards[MetricShard()];
+    shard.buckets[Histogram::BucketOf(nanoseconds)].fetch_add(
+        1,
+        memory_order_relaxed);
+
+    auto max = shard.max.load(memory_order_relaxed);
+    while (nanoseconds > max &&
+        !shard.max.compare_exchange_weak(max, nanoseconds,
+            memory_order_relaxed))
+    {
+    }
+}
+
+void MetricHistogram::Take(Histogram& result)
+{
+    uint32_t buckets[Histogram::BucketCount];
+
+    for (auto& shard : _shards)
+    {
+        for (int i = 0; i < Histogram::BucketCount; ++i)
+            buckets[i] = shard.buckets[i].exchange(0, memory_order_relaxed);
+
+        result.Add(buckets, shard.max.exchange(0, memory_order_relaxed));
+    }
+}
+
+template<typename T> static T& Register(MetricList<T>& list, const char* name)
+{
+    lock_guard<mutex> lock(TheRegistry().registryMutex);
+
+    for (auto& entry : list)
+    {
+        if (entry.first == name) return *entry.second;
+    }
+
+    list.emplace_back(name, make_unique<T>());
+    return *list.back().second;
+}
+
+MetricCounter& RegisterCounter(const char* name)
+{
+    return Register(TheRegistry().counters, name);
+}
+
+MetricGauge& RegisterGauge(const char* name)
+{
+    return Register(TheRegistry().gauges, name);
+}
+
+MetricHistogram& RegisterHistogram(const char* name)
+{
+    return Register(TheRegistry().histograms, name);
+}
+
+bool MetricsWriter::Open(const char* path)
+{
+    _stream.open(path, ofstream::binary);
+
+    if (!_stream)
+    {
+        LOG_ERROR << "Failed to open " << path << " for metrics\n";
+        return false;
+    }
+
+    return true;
+}
+
+void MetricsWriter::Write(uint64_t tick)
+{
+    if (!_stream.is_open()) return;
+
+    auto& registry = TheRegistry();
+    lock_guard<mutex> lock(registry.registryMutex);
+    _stream << "{\"tick\":" << tick;
+
+    for (const auto& entry : registry.counters)
+        _stream << ",\"" << entry.first << "\":" << entry.second->Value();
+
+    for (const auto& entry : registry.gauges)
+        _stream << ",\"" << entry.first << "\":" << entry.second->Value();
+
+    for (const auto& entry : registry.histograms)
+    {
+        Histogram histogram;
+        entry.second->Take(histogram);
+
+        _stream << ",\"" << entry.first << "\":{\"count\":"
+            << histogram.Count()
+            << ",\"p50\":" << histogram.Percentile(0.5)
+            << ",\"p90\":" << histogram.Percentile(0.9)
+            << ",\"p99\":" << histogram.Percentile(0.99)
+            << ",\"max\":" << histogram.Max() << '}';
+    }
+
+    _stream << "}\n";
+    _stream.flush();
+}
+
+void MetricsWriter::Close()
+{
+    if (_stream.is_open()) _stream.close();
+}
@@ -0,0 +1,112 @@
+#ifndef Metrics_hpp
+#define Metrics_hpp
+
+#include "Histogram.hpp"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+
+/// Process-wide named metrics. Any subsystem registers once, usually into a
+/// static reference, and then records from any thread without locking:
+///
+///     static auto& theTilesMeshed = RegisterCounter("tiles_meshed");
+///     theTilesMeshed.Add(count);
+///
+/// MetricsWriter snapshots all of them to a JSON-lines file.
+
+constexpr int MetricShardCount = 8;
+constexpr size_t MetricCacheLineSize = 64;
+
+/// Shard for the calling thread; threads are spread round-robin.
+int MetricShard();
+
+/// Monotonic total. Each thread adds into its own padded shard, and Value
+/// sums them.
+class MetricCounter
+{
+public:
+    inline void Add(int64_t amount = 1)
+    {
+        _shards[MetricShard()].value.fetch_add(
+            amount,
+            std::memory_order_relaxed);
+    }
+
+    int64_t Value() const;
+
+private:
+    struct Shard
+    {
+        std::atomic<int64_t> value{0};
+        char padding[MetricCacheLineSize - sizeof(std::atomic<int64_t>)];
+    };
+
+    Shard _shards[MetricShardCount];
+};
+
+/// Last value set, such as a queue length.
+class MetricGauge
+{
+public:
+    inline void Set(int64_t value)
+    {
+        _value.store(value, std::memory_order_relaxed);
+    }
+
+    inline void Add(int64_t amount)
+    {
+        _value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    inline int64_t Value() const
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<int64_t> _value{0};
+    char _padding[MetricCacheLineSize - sizeof(std::atomic<int64_t>)];
+};
+
+/// Distribution of nanosecond durations since the last snapshot, with
+/// Histogram's bucket layout in every shard.
+class MetricHistogram
+{
+public:
+    void Record(uint64_t nanoseconds);
+
+    /// Merges the shards into result and clears them.
+    void Take(Histogram& result);
+
+private:
+    struct Shard
+    {
+        std::atomic<uint32_t> buckets[Histogram::BucketCount];
+        std::atomic<uint64_t> max;
+        char padding[MetricCacheLineSize];
+    };
+
+    Shard _shards[MetricShardCount] = {};
+};
+
+/// Returns the metric with this name, creating it on first use. The
+/// reference stays valid for the life of the process.
+MetricCounter& RegisterCounter(const char* name);
+MetricGauge& RegisterGauge(const char* name);
+MetricHistogram& RegisterHistogram(const char* name);
+
+/// Appends one JSON object per snapshot: counters as totals, gauges as
+/// their current value, and histograms summarized since the last one.
+class MetricsWriter
+{
+public:
+    bool Open(const char* path);
+    inline bool IsOpen() const { return _stream.is_open(); }
+    void Write(uint64_t tick);
+    void Close();
+
+private:
+    std::ofstream _stream;
+};
+
+#endif
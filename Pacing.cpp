@@ -0,0 +1,60 @@
+#include "Pacing.hpp"
+#ifndef _WIN32
+#include <cerrno>
+#include <time.h>
+#endif
+using namespace std;
+
+/// How long before the deadline to stop sleeping and start spinning. It
+/// covers the timer's usual wake-up latency.
+#ifdef _WIN32
+static constexpr double SpinSeconds = 0.002;
+#else
+static constexpr double SpinSeconds = 0.0002;
+#endif
+
+static inline void Pause()
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+void WaitUntil(Uint64 deadline)
+{
+    auto now = SDL_GetPerformanceCounter();
+    if (now >= deadline) return;
+
+    auto frequency = double(SDL_GetPerformanceFrequency());
+    auto sleepSeconds = double(deadline - now) / frequency - SpinSeconds;
+
+    if (sleepSeconds > 0.0)
+    {
+#ifdef _WIN32
+        // SDL_Delay rounds down to whole milliseconds; the spin absorbs
+        // the rest.
+        SDL_Delay(Uint32(sleepSeconds * 1000.0));
+#else
+        // An absolute wake-up time cannot drift if the sleep is
+        // interrupted and resumed.
+        timespec target;
+        clock_gettime(CLOCK_MONOTONIC, &target);
+
+        auto seconds = time_t(sleepSeconds);
+        auto nanoseconds = target.tv_nsec +
+            long((sleepSeconds - double(seconds)) * 1e9);
+        target.tv_sec += seconds + nanoseconds / 1000000000;
+        target.tv_nsec = nanoseconds % 1000000000;
+
+        while (clock_nanosleep(
+            CLOCK_MONOTONIC,
+            TIMER_ABSTIME,
+            &target,
+            nullptr) == EINTR)
+        {
+        }
+#endif
+    }
+
+    while (SDL_GetPerformanceCounter() < deadline) Pause();
+}
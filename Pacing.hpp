@@ -0,0 +1,12 @@
+#ifndef Pacing_hpp
+#define Pacing_hpp
+
+#include <SDL.h>
+
+/// Blocks until the performance counter reaches deadline. Sleeps on the
+/// OS high-resolution timer until just short of it, then spins the rest,
+/// so the wake-up lands within microseconds instead of SDL_Delay's
+/// millisecond.
+void WaitUntil(Uint64 deadline);
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef PointArray_hpp
+#define PointArray_hpp
+
+#include "Point.hpp"
+#include "Span.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+/// Alignment of each PointArray axis, and the size of a block, in bytes:
+/// one SSE or NEON register, the widest every build enables.
+constexpr size_t PointArrayAlignment = 16;
+
+/// Points stored as separate, aligned x and y arrays (structure of
+/// arrays), for particle and entity fields. The batch operations below
+/// work a block at a time through GCC vector extensions, which compile to
+/// SSE on x86 and NEON on ARM, with no per-ISA code.
+///
+/// Each axis is padded to whole blocks. Operations run over the padding
+/// too, so it holds junk; only the first Count() elements mean anything.
+template<typename T> class PointArray
+{
+public:
+    /// Elements per block: one PointArrayAlignment-sized vector.
+    static constexpr int Lanes = int(PointArrayAlignment / sizeof(T));
+
+    typedef T Block __attribute__((
+        vector_size(PointArrayAlignment),
+        may_alias));
+
+private:
+    std::unique_ptr<T[]> _storage;
+    T* _x = nullptr;
+    T* _y = nullptr;
+    int _count = 0;
+    int _paddedCount = 0;
+
+public:
+    PointArray() = default;
+
+    /// count points at the origin.
+    explicit PointArray(int count)
+    {
+        Resize(count);
+    }
+
+    PointArray(const PointArray<T>& other) : PointArray(other._count)
+    {
+        std::copy(other._x, other._x + _paddedCount, _x);
+        std::copy(other._y, other._y + _paddedCount, _y);
+    }
+
+    /// Leaves other empty.
+    PointArray(PointArray<T>&& other)
+    {
+        Swap(other);
+    }
+
+    PointArray<T>& operator=(PointArray<T> other)
+    {
+        Swap(other);
+        return *this;
+    }
+
+    void Swap(PointArray<T>& other)
+    {
+        std::swap(_storage, other._storage);
+        std::swap(_x, other._x);
+        std::swap(_y, other._y);
+        std::swap(_count, other._count);
+        std::swap(_paddedCount, other._paddedCount);
+    }
+
+    /// Keeps the first Min(count, Count()) points; new ones are zero.
+    void Resize(int count)
+    {
+        int paddedCount = (count + Lanes - 1) / Lanes * Lanes;
+        if (paddedCount != _paddedCount)
+        {
+            // One allocation for both axes, with slack to align the first.
+            std::unique_ptr<T[]> storage(new T[paddedCount * 2 + Lanes]());
+            void* start = storage.get();
+            size_t space = sizeof(T) * (paddedCount * 2 + Lanes);
+            std::align(PointArrayAlignment, sizeof(T), start, space);
+
+            auto x = static_cast<T*>(start);
+            auto y = x + paddedCount;
+            auto kept = Min(count, _count);
+            std::copy(_x, _x + kept, x);
+            std::copy(_y, _y + kept, y);
+
+            _storage = std::move(storage);
+            _x = x;
+            _y = y;
+            _paddedCount = paddedCount;
+        }
+
+        for (int i = Min(count, _count); i < _paddedCount; ++i)
+            _x[i] = _y[i] = T(0);
+
+        _count = count;
+    }
+
+    inline int Count() const { return _count; }
+    inline int BlockCount() const { return _paddedCount / Lanes; }
+
+    inline T* X() { return _x; }
+    inline T* Y() { return _y; }
+    inline const T* X() const { return _x; }
+    inline const T* Y() const { return _y; }
+
+    inline Block* XBlocks() { return reinterpret_cast<Block*>(_x); }
+    inline Block* YBlocks() { return reinterpret_cast<Block*>(_y); }
+
+    inline const Block* XBlocks() const
+    {
+        return reinterpret_cast<const Block*>(_x);
+    }
+
+    inline const Block* YBlocks() const
+    {
+        return reinterpret_cast<const Block*>(_y);
+    }
+
+    inline Point<T> Get(int index) const { return {_x[index], _y[index]}; }
+
+    inline void Set(int index, Point<T> p)
+    {
+        _x[index] = p.x;
+        _y[index] = p.y;
+    }
+
+    /// Replaces the contents with points.
+    void Assign(Span<const Point<T>> points)
+    {
+        Resize(points.count);
+        for (int i = 0; i < points.count; ++i) Set(i, points.data[i]);
+    }
+
+    /// Writes the first points.count points out; points.count <= Count().
+    void CopyTo(Span<Point<T>> points) const
+    {
+        for (int i = 0; i < points.count; ++i) points.data[i] = Get(i);
+    }
+};
+
+/// a += b, pointwise; b has at least a's count.
+template<typename T> void Add(PointArray<T>& a, const PointArray<T>& b)
+{
+    auto ax = a.XBlocks();
+    auto ay = a.YBlocks();
+    auto bx = b.XBlocks();
+    auto by = b.YBlocks();
+
+    for (int i = 0; i < a.BlockCount(); ++i)
+    {
+        ax[i] += bx[i];
+        ay[i] += by[i];
+    }
+}
+
+/// a += offset for every point.
+template<typename T> void Add(PointArray<T>& a, Point<T> offset)
+{
+    auto ax = a.XBlocks();
+    auto ay = a.YBlocks();
+
+    for (int i = 0; i < a.BlockCount(); ++i)
+    {
+        ax[i] += offset.x;
+        ay[i] += offset.y;
+    }
+}
+
+/// a *= multiplier for every point.
+template<typename T> void Scale(PointArray<T>& a, T multiplier)
+{
+    auto ax = a.XBlocks();
+    auto ay = a.YBlocks();
+
+    for (int i = 0; i < a.BlockCount(); ++i)
+    {
+        ax[i] *= multiplier;
+        ay[i] *= multiplier;
+    }
+}
+
+/// Point::Restricted for every point.
+template<typename T> void Restrict(
+    PointArray<T>& a, T lowX, T highX, T lowY, T highY)
+{
+    typedef typename PointArray<T>::Block Block;
+    auto ax = a.XBlocks();
+    auto ay = a.YBlocks();
+    Block lowXs = Block{} + lowX;
+    Block highXs = Block{} + highX;
+    Block lowYs = Block{} + lowY;
+    Block highYs = Block{} + highY;
+
+    // Max(Min(value, high), low), as Restricted does it.
+    for (int i = 0; i < a.BlockCount(); ++i)
+    {
+        Block x = ax[i] < highXs ? ax[i] : highXs;
+        Block y = ay[i] < highYs ? ay[i] : highYs;
+        ax[i] = lowXs < x ? x : lowXs;
+        ay[i] = lowYs < y ? y : lowYs;
+    }
+}
+
+/// result[i] = f(a[i], b[i]), with f taking x and y terms. f is called
+/// on whole blocks, then on the scalars of the tail, since result isn't
+/// padded.
+template<typename T, typename F> void MapPointArrays(
+    const PointArray<T>& a,
+    const PointArray<T>& b,
+    Span<T> result,
+    F&& f)
+{
+    constexpr int Lanes = PointArray<T>::Lanes;
+    auto ax = a.XBlocks();
+    auto ay = a.YBlocks();
+    auto bx = b.XBlocks();
+    auto by = b.YBlocks();
+    int blockCount = result.count / Lanes;
+
+    for (int i = 0; i < blockCount; ++i)
+    {
+        auto block = f(ax[i], ay[i], bx[i], by[i]);
+        memcpy(result.data + i * Lanes, &block, sizeof(block));
+    }
+
+    for (int i = blockCount * Lanes; i < result.count; ++i)
+        result.data[i] = f(a.X()[i], a.Y()[i], b.X()[i], b.Y()[i]);
+}
+
+/// result[i] = LengthSquared(a[i]); result.count <= a.Count().
+template<typename T> void LengthSquared(const PointArray<T>& a, Span<T> result)
+{
+    MapPointArrays(a, a, result, [](auto x, auto y, auto, auto)
+    {
+        return x * x + y * y;
+    });
+}
+
+/// result[i] = CrossZ(a[i], b[i]); result.count <= both counts.
+template<typename T> void CrossZ(
+    const PointArray<T>& a,
+    const PointArray<T>& b,
+    Span<T> result)
+{
+    MapPointArrays(a, b, result, [](auto ax, auto ay, auto bx, auto by)
+    {
+        return ax * by - ay * bx;
+    });
+}
+
+#endif
@@ -0,0 +1,54 @@
+#include "Process.hpp"
+#include <SDL.h>
+#ifdef _WIN32
+#define PSAPI_VERSION 2
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+using namespace std;
+
+double ProcessCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creation;
+    FILETIME exit;
+    FILETIME kernel;
+    FILETIME user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+        return 0.0;
+
+    auto ticks = [](FILETIME t)
+    {
+        return double((Uint64(t.dwHighDateTime) << 32) | t.dwLowDateTime);
+    };
+
+    return (ticks(kernel) + ticks(user)) / 1e7;
+#else
+    timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return double(t.tv_sec) + double(t.tv_nsec) / 1e9;
+#endif
+}
+
+size_t PeakMemoryBytes()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage)) return 0;
+
+#ifdef __APPLE__
+    return size_t(usage.ru_maxrss);
+#else
+    return size_t(usage.ru_maxrss) * 1024; // Reported in kilobytes.
+#endif
+#endif
+}
@@ -0,0 +1,12 @@
+#ifndef Process_hpp
+#define Process_hpp
+
+#include <cstddef>
+
+/// CPU time consumed by the whole process so far, across all threads.
+double ProcessCpuSeconds();
+
+/// Most physical memory the process has held at once, in bytes.
+size_t PeakMemoryBytes();
+
+#endif
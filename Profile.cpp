@@ -0,0 +1,193 @@
+#include "Profile.hpp"
+#include "Debug.hpp"
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+#ifdef KerrariaProfile
+
+/// Events each thread keeps; older ones are overwritten.
+static constexpr size_t ProfileEventCapacity = 1 << 16;
+
+struct ProfileEvent
+{
+    const char* name;
+    Uint64 start;
+    Uint64 end;
+    int64_t value;
+    bool isCounter;
+};
+
+/// One thread's ring of events. Only its own thread writes, so the mutex
+/// is uncontended except while a trace is being written.
+struct ProfileThread
+{
+    mutex eventMutex;
+    vector<ProfileEvent> events;
+    uint64_t eventCount = 0;
+    int id = 0;
+    const char* name = nullptr;
+};
+
+// Threads are never removed, so a trace still shows work done by threads
+// that have since exited.
+static mutex theThreadMutex;
+static vector<unique_ptr<ProfileThread>> theThreads;
+
+static ProfileThread* AddThread()
+{
+    lock_guard<mutex> lock(theThreadMutex);
+    theThreads.push_back(make_unique<ProfileThread>());
+
+    auto thread = theThreads.back().get();
+    thread->events.resize(ProfileEventCapacity);
+    thread->id = int(theThreads.size());
+    return thread;
+}
+
+static ProfileThread& ThisThread()
+{
+    thread_local ProfileThread* thread = AddThread();
+    return *thread;
+}
+
+static void Record(const ProfileEvent& event)
+{
+    auto& thread = ThisThread();
+    lock_guard<mutex> lock(thread.eventMutex);
+    thread.events[thread.eventCount++ % ProfileEventCapacity] = event;
+}
+
+void RecordProfileZone(const char* name, Uint64 start, Uint64 end)
+{
+    Record({name, start, end, 0, false});
+}
+
+void RecordProfileCounter(const char* name, int64_t value)
+{
+    auto now = SDL_GetPerformanceCounter();
+    Record({name, now, now, value, true});
+}
+
+void SetProfileThreadName(const char* name)
+{
+    auto& thread = ThisThread();
+    lock_guard<mutex> lock(thread.eventMutex);
+    thread.name = name;
+}
+
+bool WriteProfileTrace(const char* path, double seconds)
+{
+    auto frequency = SDL_GetPerformanceFrequency();
+    auto now = SDL_GetPerformanceCounter();
+    auto window = Uint64(seconds * double(frequency));
+    auto cutoff = now > window ? now - window : 0;
+
+    struct ThreadEvents
+    {
+        int id;
+        const char* name;
+        vector<ProfileEvent> events;
+    };
+
+    // Copy out first so no thread is held up by the file writes.
+    vector<ThreadEvents> threads;
+    auto origin = now;
+    size_t eventCount = 0;
+
+    {
+        lock_guard<mutex> threadLock(theThreadMutex);
+
+        for (auto& thread : theThreads)
+        {
+            lock_guard<mutex> lock(thread->eventMutex);
+            ThreadEvents copy{thread->id, thread->name, {}};
+
+            auto end = thread->eventCount;
+            auto count = min<uint64_t>(end, ProfileEventCapacity);
+
+            for (auto i = end - count; i < end; ++i)
+            {
+                const auto& event = thread->events[i % ProfileEventCapacity];
+                if (event.end < cutoff) continue;
+
+                copy.events.push_back(event);
+                if (event.start < origin) origin = event.start;
+            }
+
+            eventCount += copy.events.size();
+            threads.push_back(move(copy));
+        }
+    }
+
+    ofstream fout(path, ofstream::binary);
+    if (!fout)
+    {
+        LOG_ERROR << "Failed to open " << path << " for the profile trace\n";
+        return false;
+    }
+
+    auto toMicroseconds = 1000000.0 / double(frequency);
+    fout.setf(ios::fixed);
+    fout.precision(3);
+    fout << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    const char* separator = "\n";
+    for (const auto& thread : threads)
+    {
+        fout << separator << "{\"ph\":\"M\",\"name\":\"thread_name\","
+            "\"pid\":1,\"tid\":" << thread.id << ",\"args\":{\"name\":\"";
+        if (thread.name)
+            fout << thread.name;
+        else
+            fout << "thread " << thread.id;
+        fout << "\"}}";
+        separator = ",\n";
+
+        for (const auto& event : thread.events)
+        {
+            auto timestamp = double(event.start - origin) * toMicroseconds;
+            fout << separator << "{\"name\":\"" << event.name
+                << "\",\"pid\":1,\"tid\":" << thread.id
+                << ",\"ts\":" << timestamp;
+
+            if (event.isCounter)
+            {
+                fout << ",\"ph\":\"C\",\"args\":{\"value\":" << event.value
+                    << "}}";
+            }
+            else
+            {
+                fout << ",\"ph\":\"X\",\"dur\":"
+                    << (double(event.end - event.start) * toMicroseconds)
+                    << '}';
+            }
+        }
+    }
+
+    fout << "\n]}\n";
+
+    if (!fout)
+    {
+        LOG_ERROR << "Failed to write the profile trace to " << path << '\n';
+        return false;
+    }
+
+    LOG_INFO << "Wrote " << eventCount << " profile events from "
+        << threads.size() << " threads to " << path << '\n';
+    return true;
+}
+
+#else
+
+bool WriteProfileTrace(const char* path, double seconds)
+{
+    (void)path;
+    (void)seconds;
+    LOG_WARNING << "Profiling is compiled out; rebuild with make PROFILE=1\n";
+    return false;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef Profile_hpp
+#define Profile_hpp
+
+#include <SDL.h>
+#include <cstdint>
+
+/// Instrumentation for Chrome trace export. Build with -DKerrariaProfile
+/// (make PROFILE=1) to record; otherwise every macro below expands to
+/// nothing and its arguments are never evaluated.
+///
+/// Zone and counter names must be string literals: only the pointer is
+/// stored.
+#ifdef KerrariaProfile
+
+void RecordProfileZone(const char* name, Uint64 start, Uint64 end);
+void RecordProfileCounter(const char* name, int64_t value);
+void SetProfileThreadName(const char* name);
+
+/// Records the time from construction to destruction as one zone on the
+/// calling thread.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+        : _name(name), _start(SDL_GetPerformanceCounter())
+    {
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    ~ProfileScope()
+    {
+        RecordProfileZone(_name, _start, SDL_GetPerformanceCounter());
+    }
+
+private:
+    const char* _name;
+    Uint64 _start;
+};
+
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#define PROFILE_ZONE(name) \
+    ProfileScope PROFILE_JOIN(theProfileScope, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) \
+    RecordProfileCounter(name, int64_t(value))
+#define PROFILE_THREAD(name) SetProfileThreadName(name)
+
+#else
+
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+
+#endif
+
+/// Writes what every thread recorded in the last `seconds` as Chrome trace
+/// JSON, which Perfetto and chrome://tracing open. Returns false, after
+/// logging why, if the file can't be written or profiling is compiled out.
+bool WriteProfileTrace(const char* path, double seconds);
+
+#endif
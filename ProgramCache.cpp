@@ -0,0 +1,176 @@
+#include "ProgramCache.hpp"
+#include "Debug.hpp"
+#include <SDL.h>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#ifdef KerrariaES2
+#include <GLES2/gl2ext.h>
+#endif
+using namespace std;
+
+static constexpr const char* CachePath = "program.cache";
+static const char Magic[4] = {'K', 'R', 'P', 'C'};
+
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t format;
+    uint64_t key;
+    uint64_t length;
+};
+
+#ifdef KerrariaES2
+static PFNGLGETPROGRAMBINARYOESPROC theGetProgramBinary;
+static PFNGLPROGRAMBINARYOESPROC theProgramBinary;
+static constexpr GLenum ProgramBinaryLength = GL_PROGRAM_BINARY_LENGTH_OES;
+static constexpr GLenum NumProgramBinaryFormats =
+    GL_NUM_PROGRAM_BINARY_FORMATS_OES;
+#else
+static constexpr GLenum ProgramBinaryLength = GL_PROGRAM_BINARY_LENGTH;
+static constexpr GLenum NumProgramBinaryFormats =
+    GL_NUM_PROGRAM_BINARY_FORMATS;
+#endif
+
+static bool CheckSupport()
+{
+#ifdef KerrariaES2
+    auto extensions = (const char*)glGetString(GL_EXTENSIONS);
+    if (!extensions || !strstr(extensions, "GL_OES_get_program_binary"))
+        return false;
+
+    theGetProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)
+        SDL_GL_GetProcAddress("glGetProgramBinaryOES");
+    theProgramBinary = (PFNGLPROGRAMBINARYOESPROC)
+        SDL_GL_GetProcAddress("glProgramBinaryOES");
+
+    if (!theGetProgramBinary || !theProgramBinary) return false;
+#else
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+#endif
+
+    // Drivers may advertise the entry points yet offer no formats.
+    GLint formatCount = 0;
+    glGetIntegerv(NumProgramBinaryFormats, &formatCount);
+    return formatCount > 0;
+}
+
+static bool IsSupported()
+{
+    static const bool isSupported = CheckSupport();
+    return isSupported;
+}
+
+/// FNV-1a, which is plenty to tell shader revisions apart.
+static uint64_t Hash(uint64_t hash, const char* text)
+{
+    if (!text) text = "";
+
+    for (; *text; ++text)
+    {
+        hash ^= uint8_t(*text);
+        hash *= 1099511628211ull;
+    }
+
+    // Separator, so "ab" + "c" and "a" + "bc" differ.
+    hash ^= 0xff;
+    hash *= 1099511628211ull;
+    return hash;
+}
+
+uint64_t ProgramKey(
+    const char* vertexShaderSource,
+    const char* fragmentShaderSource)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hash = Hash(hash, vertexShaderSource);
+    hash = Hash(hash, fragmentShaderSource);
+    hash = Hash(hash, (const char*)glGetString(GL_VENDOR));
+    hash = Hash(hash, (const char*)glGetString(GL_RENDERER));
+    hash = Hash(hash, (const char*)glGetString(GL_VERSION));
+    return hash;
+}
+
+void PrepareProgramBinary(GLuint program)
+{
+#ifndef KerrariaES2
+    if (IsSupported())
+    {
+        glProgramParameteri(
+            program,
+            GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+            GL_TRUE);
+    }
+#else
+    (void)program;
+#endif
+}
+
+bool LoadProgramBinary(GLuint program, uint64_t key)
+{
+    if (!IsSupported()) return false;
+
+    ifstream stream(CachePath, ifstream::binary);
+    if (!stream) return false;
+
+    CacheHeader header;
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, Magic, sizeof(Magic)) ||
+        header.key != key ||
+        header.length > (64u << 20))
+    {
+        return false;
+    }
+
+    vector<char> binary(header.length);
+    if (!stream.read(binary.data(), binary.size())) return false;
+
+#ifdef KerrariaES2
+    theProgramBinary(program, header.format, binary.data(), binary.size());
+#else
+    glProgramBinary(program, header.format, binary.data(), binary.size());
+#endif
+
+    GLint isLinked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+
+    if (isLinked == GL_FALSE)
+    {
+        LOG_WARNING << "cached program binary rejected\n";
+        return false;
+    }
+
+    return true;
+}
+
+void SaveProgramBinary(GLuint program, uint64_t key)
+{
+    if (!IsSupported()) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, ProgramBinaryLength, &length);
+    if (length < 1) return;
+
+    vector<char> binary(length);
+    GLenum format = 0;
+
+#ifdef KerrariaES2
+    theGetProgramBinary(program, length, &length, &format, binary.data());
+#else
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+#endif
+
+    if (length < 1) return;
+
+    CacheHeader header = {};
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.format = format;
+    header.key = key;
+    header.length = uint64_t(length);
+
+    ofstream stream(CachePath, ofstream::binary);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    stream.write(binary.data(), length);
+
+    if (!stream) LOG_ERROR << "failed to write " << CachePath << '\n';
+}
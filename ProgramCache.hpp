@@ -0,0 +1,27 @@
+#ifndef ProgramCache_hpp
+#define ProgramCache_hpp
+
+#include "OpenGL.hpp"
+#include <cstdint>
+
+/// Caches linked shader programs on disk with glGetProgramBinary so later
+/// launches can skip compiling and linking. The key covers the shader
+/// sources and the GL vendor, renderer and version strings, so a driver
+/// update or shader edit simply misses. Everything here quietly does
+/// nothing when the driver has no program binary support.
+
+uint64_t ProgramKey(
+    const char* vertexShaderSource,
+    const char* fragmentShaderSource);
+
+/// Call between attaching shaders and linking so the driver keeps the
+/// binary around for SaveProgramBinary.
+void PrepareProgramBinary(GLuint program);
+
+/// Loads a cached binary for the key into the program. Returns false if
+/// there is none, or if the driver rejects it.
+bool LoadProgramBinary(GLuint program, uint64_t key);
+
+void SaveProgramBinary(GLuint program, uint64_t key);
+
+#endif
@@ -3,7 +3,106 @@
 
 #include <iostream>
 #include <cstdint>
+#include <type_traits>
+#include <utility>
 
+template<typename T> constexpr typename std::make_unsigned<T>::type
+    Magnitude(T value)
+{
+    using U = typename std::make_unsigned<T>::type;
+    return value < 0 ? U(U(0) - U(value)) : U(value);
+}
+
+/// Stein's binary GCD: shifts and subtractions only, O(bits) steps.
+/// BinaryGcd(0, n) is n.
+template<typename U> U BinaryGcd(U u, U v)
+{
+    if (!u) return v;
+    if (!v) return u;
+
+    int shift = __builtin_ctzll(uint64_t(u | v));
+    u >>= __builtin_ctzll(uint64_t(u));
+
+    do
+    {
+        v >>= __builtin_ctzll(uint64_t(v));
+        if (u > v) std::swap(u, v);
+        v -= u;
+    } while (v);
+
+    return U(u << shift);
+}
+
+/// Non-negative GCD of the magnitudes.
+template<typename T> T Gcd(T x, T y)
+{
+    return T(BinaryGcd(Magnitude(x), Magnitude(y)));
+}
+
+/// Signed 128-bit product of two 64-bit values, for targets without
+/// __int128. Two's complement, high word first so comparisons read
+/// naturally.
+struct Int128
+{
+    int64_t high;
+    uint64_t low;
+};
+
+inline Int128 Multiply128(int64_t x, int64_t y)
+{
+    uint64_t ux = Magnitude(x);
+    uint64_t uy = Magnitude(y);
+
+    // Schoolbook multiplication on 32-bit halves.
+    uint64_t lowLow = (ux & 0xffffffff) * (uy & 0xffffffff);
+    uint64_t highLow = (ux >> 32) * (uy & 0xffffffff);
+    uint64_t lowHigh = (ux & 0xffffffff) * (uy >> 32);
+    uint64_t highHigh = (ux >> 32) * (uy >> 32);
+
+    uint64_t middle = (lowLow >> 32) + (highLow & 0xffffffff) +
+        (lowHigh & 0xffffffff);
+    uint64_t low = (middle << 32) | (lowLow & 0xffffffff);
+    uint64_t high = highHigh + (highLow >> 32) + (lowHigh >> 32) +
+        (middle >> 32);
+
+    if ((x < 0) != (y < 0))
+    {
+        low = ~low + 1;
+        high = ~high + (low == 0);
+    }
+
+    return {int64_t(high), low};
+}
+
+constexpr bool operator<(Int128 x, Int128 y)
+{
+    return x.high < y.high || (x.high == y.high && x.low < y.low);
+}
+
+/// Integer type that holds any product of two Ts.
+template<typename T> struct WideOf;
+template<> struct WideOf<int8_t> { typedef int16_t Type; };
+template<> struct WideOf<int16_t> { typedef int32_t Type; };
+template<> struct WideOf<int32_t> { typedef int64_t Type; };
+
+template<typename T> typename WideOf<T>::Type WideProduct(T x, T y)
+{
+    return typename WideOf<T>::Type(x) * y;
+}
+
+#ifdef __SIZEOF_INT128__
+template<> struct WideOf<int64_t> { typedef __int128 Type; };
+#else
+template<> struct WideOf<int64_t> { typedef Int128 Type; };
+
+inline Int128 WideProduct(int64_t x, int64_t y)
+{
+    return Multiply128(x, y);
+}
+#endif
+
+/// a / b. Arithmetic keeps the result in lowest terms, dividing out common
+/// factors before multiplying so intermediate products stay small.
 template<typename T> struct Rational
 {
     T a;
@@ -11,30 +110,35 @@ template<typename T> struct Rational
 
     Rational<T>& operator+=(Rational<T> other)
     {
-        a = a * other.b + other.a * b;
-        b *= other.b;
-        return *this;
+        // Scale to the least common denominator, not the product.
+        T g = Gcd(b, other.b);
+        if (!g) g = 1;
+
+        a = a * (other.b / g) + other.a * (b / g);
+        b = b / g * other.b;
+        return *this = Reduced(*this);
     }
 
     Rational<T>& operator-=(Rational<T> other)
     {
-        a = a * other.b - other.a * b;
-        b *= other.b;
-        return *this;
+        return *this += Rational<T>{T(-other.a), other.b};
     }
 
     Rational<T>& operator*=(Rational<T> other)
     {
-        a *= other.a;
-        b *= other.b;
-        return *this;
+        T g1 = Gcd(a, other.b);
+        T g2 = Gcd(other.a, b);
+        if (!g1) g1 = 1;
+        if (!g2) g2 = 1;
+
+        a = (a / g1) * (other.a / g2);
+        b = (b / g2) * (other.b / g1);
+        return *this = Reduced(*this);
     }
 
     Rational<T>& operator/=(Rational<T> other)
     {
-        a *= other.b;
-        b *= other.a;
-        return *this;
+        return *this *= Rational<T>{other.b, other.a};
     }
 };
 
@@ -55,64 +159,60 @@ template<typename T> Rational<T> Reduced(Rational<T> r)
     if (r.a == 0) return {0,1};
 
     r = Normalized(r);
+    T g = Gcd(r.a, r.b);
+    return {T(r.a / g), T(r.b / g)};
+}
 
-    bool isNegative = r.a < 0;
-
-    if (isNegative) r.a = -r.a;
-
-    if (!(r.a & 1) && !(r.b & 1)) r.a >>= 1, r.b >>= 1;
+/// Sign of a - b. The cross products are taken at twice the width of T,
+/// so no pair of valid rationals can overflow; when every term fits in
+/// under half the bits of T, as most do, they are taken in T.
+template<typename T> int Compare(Rational<T> a, Rational<T> b)
+{
+    a = Normalized(a);
+    b = Normalized(b);
 
-    const T* low = r.a < r.b ? &r.a : &r.b;
-    for (T i = 3; i <= *low; i += 2)
+    constexpr auto HalfBits = sizeof(T) * 4 - 1;
+    if (!((Magnitude(a.a) | Magnitude(a.b) | Magnitude(b.a) |
+        Magnitude(b.b)) >> HalfBits))
     {
-        if (!(r.a % i) && !(r.b % i)) r.a /= i, r.b /= i;
+        T left = a.a * b.b;
+        T right = b.a * a.b;
+        return left < right ? -1 : right < left ? 1 : 0;
     }
 
-    if (isNegative) r.a = -r.a;
-
-    return r;
+    auto left = WideProduct(a.a, b.b);
+    auto right = WideProduct(b.a, a.b);
+    return left < right ? -1 : right < left ? 1 : 0;
 }
 
 template<typename T> bool operator==(Rational<T> a, Rational<T> b)
 {
-    a = Normalized(a);
-    b = Normalized(b);
-    return a.a * b.b == b.a * a.b;
+    return Compare(a, b) == 0;
 }
 
 template<typename T> bool operator!=(Rational<T> a, Rational<T> b)
 {
-    a = Normalized(a);
-    b = Normalized(b);
-    return a.a * b.b != b.a * a.b;
+    return Compare(a, b) != 0;
 }
 
 template<typename T> bool operator<(Rational<T> a, Rational<T> b)
 {
-    a = Normalized(a);
-    b = Normalized(b);
-    return a.a * b.b < b.a * a.b;
+    return Compare(a, b) < 0;
 }
 
 template<typename T> bool operator>(Rational<T> a, Rational<T> b)
 {
-    a = Normalized(a);
-    b = Normalized(b);
-    return a.a * b.b > b.a * a.b;
+    return Compare(a, b) > 0;
 }
 
 template<typename T> bool operator<=(Rational<T> a, Rational<T> b)
 {
-    a = Normalized(a);
-    b = Normalized(b);
-    return a.a * b.b <= b.a * a.b;
+    return Compare(a, b) <= 0;
 }
 
 template<typename T> bool operator>=(Rational<T> a, Rational<T> b)
 {
-    a = Normalized(a);
-    b = Normalized(b);
-    return a.a * b.b >= b.a * a.b;
+    return Compare(a, b) >= 0;
 }
 
 typedef Rational<int8_t> Rational8;
@@ -0,0 +1,240 @@
+#include "Raycast.hpp"
+#include "Jobs.hpp"
+#include <cmath>
+#include <limits>
+using namespace std;
+
+/// Rays per job when a batch is split.
+static constexpr int RayGrain = 64;
+
+static constexpr float Infinity = numeric_limits<float>::infinity();
+
+static inline bool IsSolid(const Grid& grid, Point<int> tile)
+{
+    return grid.tiles[size_t(tile.x) * grid.size.y + tile.y] != NoTile;
+}
+
+static inline Point<int> ChunkCount(Point<int> size)
+{
+    return {
+        (size.x + OccupancyChunkSize - 1) / OccupancyChunkSize,
+        (size.y + OccupancyChunkSize - 1) / OccupancyChunkSize};
+}
+
+static uint16_t CountSolid(const Grid& grid, Point<int> chunk)
+{
+    auto low = chunk * OccupancyChunkSize;
+    auto high = Point<int>{
+        Min(low.x + OccupancyChunkSize, grid.size.x),
+        Min(low.y + OccupancyChunkSize, grid.size.y)};
+
+    uint16_t count = 0;
+    for (int x = low.x; x < high.x; ++x)
+    {
+        for (int y = low.y; y < high.y; ++y)
+            count += IsSolid(grid, {x, y});
+    }
+
+    return count;
+}
+
+void TileOccupancy::Compute(const Grid& grid)
+{
+    _chunkCount = ChunkCount(grid.size);
+    _solidCounts.resize(size_t(_chunkCount.x) * _chunkCount.y);
+
+    for (int x = 0; x < _chunkCount.x; ++x)
+    {
+        for (int y = 0; y < _chunkCount.y; ++y)
+            _solidCounts[x * _chunkCount.y + y] = CountSolid(grid, {x, y});
+    }
+}
+
+void TileOccupancy::Update(const Grid& grid, Point<int> position)
+{
+    if (ChunkCount(grid.size) != _chunkCount)
+    {
+        Compute(grid);
+        return;
+    }
+
+    auto chunk = position / OccupancyChunkSize;
+    _solidCounts[chunk.x * _chunkCount.y + chunk.y] = CountSolid(grid, chunk);
+}
+
+/// Time the ray reaches grid line boundary on one axis.
+static inline float TimeTo(int boundary, float start, float inverse)
+{
+    if (inverse == Infinity) return Infinity;
+    return (float(boundary) - start) * inverse;
+}
+
+static RayHit Cast(
+    const Grid& grid,
+    const TileOccupancy* occupancy,
+    LineSegment<float> ray)
+{
+    RayHit hit;
+    auto start = ray.p1;
+    auto delta = ray.p2 - ray.p1;
+
+    // Clip to the grid, noting which face the ray enters through.
+    float enter = 0.0f;
+    float exit = 1.0f;
+    Point<int> normal = {0, 0};
+    float starts[] = {start.x, start.y};
+    float deltas[] = {delta.x, delta.y};
+    int sizes[] = {grid.size.x, grid.size.y};
+
+    for (int axis = 0; axis < 2; ++axis)
+    {
+        if (deltas[axis] == 0.0f)
+        {
+            if (starts[axis] < 0.0f || starts[axis] >= float(sizes[axis]))
+                return hit;
+            continue;
+        }
+
+        float near = -starts[axis] / deltas[axis];
+        float far = (float(sizes[axis]) - starts[axis]) / deltas[axis];
+        int side = 1;
+        if (near > far) swap(near, far), side = -1;
+
+        if (near > enter)
+        {
+            enter = near;
+            normal = axis ? Point<int>{0, -side} : Point<int>{-side, 0};
+        }
+
+        exit = Min(exit, far);
+    }
+
+    if (enter > exit) return hit;
+
+    Point<int> step = {
+        delta.x > 0.0f ? 1 : delta.x < 0.0f ? -1 : 0,
+        delta.y > 0.0f ? 1 : delta.y < 0.0f ? -1 : 0};
+    Point<float> inverse = {
+        step.x ? 1.0f / delta.x : Infinity,
+        step.y ? 1.0f / delta.y : Infinity};
+
+    // A ray starting on a grid line belongs to the tile it moves into.
+    auto entry = start + delta * enter;
+    Point<int> tile = {
+        step.x < 0 ? int(ceil(entry.x)) - 1 : int(floor(entry.x)),
+        step.y < 0 ? int(ceil(entry.y)) - 1 : int(floor(entry.y))};
+    tile = tile.Restricted(0, grid.size.x - 1, 0, grid.size.y - 1);
+    float time = enter;
+
+    while (true)
+    {
+        auto chunk = tile / OccupancyChunkSize;
+
+        if (occupancy && occupancy->IsEmpty(chunk))
+        {
+            // Leave the chunk in one step: onto the first tile past its
+            // far edge on whichever axis the ray reaches first.
+            auto low = chunk * OccupancyChunkSize;
+            auto high = low + Point<int>{
+                OccupancyChunkSize - 1,
+                OccupancyChunkSize - 1};
+            float timeX = TimeTo(step.x > 0 ? high.x + 1 : low.x,
+                start.x, inverse.x);
+            float timeY = TimeTo(step.y > 0 ? high.y + 1 : low.y,
+                start.y, inverse.y);
+
+            if (timeX <= timeY)
+            {
+                time = timeX;
+                tile.x = step.x > 0 ? high.x + 1 : low.x - 1;
+                tile.y = Restricted(
+                    int(floor(start.y + delta.y * time)),
+                    low.y,
+                    high.y);
+                normal = {-step.x, 0};
+            }
+            else
+            {
+                time = timeY;
+                tile.y = step.y > 0 ? high.y + 1 : low.y - 1;
+                tile.x = Restricted(
+                    int(floor(start.x + delta.x * time)),
+                    low.x,
+                    high.x);
+                normal = {0, -step.y};
+            }
+        }
+        else
+        {
+            ++hit.visitedCount;
+
+            if (IsSolid(grid, tile))
+            {
+                hit.time = time;
+                hit.normal = normal;
+                hit.tile = tile;
+                hit.isHit = true;
+                return hit;
+            }
+
+            float timeX = TimeTo(tile.x + (step.x > 0), start.x, inverse.x);
+            float timeY = TimeTo(tile.y + (step.y > 0), start.y, inverse.y);
+
+            if (timeX <= timeY)
+            {
+                time = timeX;
+                tile.x += step.x;
+                normal = {-step.x, 0};
+            }
+            else
+            {
+                time = timeY;
+                tile.y += step.y;
+                normal = {0, -step.y};
+            }
+        }
+
+        if (time > exit ||
+            tile.x < 0 || tile.y < 0 ||
+            tile.x >= grid.size.x || tile.y >= grid.size.y) return hit;
+    }
+}
+
+RayHit CastRay(const Grid& grid, LineSegment<float> ray)
+{
+    return Cast(grid, nullptr, ray);
+}
+
+RayHit CastRay(
+    const Grid& grid,
+    const TileOccupancy& occupancy,
+    LineSegment<float> ray)
+{
+    return Cast(grid, &occupancy, ray);
+}
+
+void CastRays(
+    const Grid& grid,
+    const TileOccupancy& occupancy,
+    Span<const LineSegment<float>> rays,
+    Span<RayHit> hits)
+{
+    for (int i = 0; i < rays.count; ++i)
+        hits.data[i] = Cast(grid, &occupancy, rays.data[i]);
+}
+
+void CastRays(
+    JobSystem& jobs,
+    const Grid& grid,
+    const TileOccupancy& occupancy,
+    Span<const LineSegment<float>> rays,
+    Span<RayHit> hits)
+{
+    Span2D<RayHit> span = {hits.data, rays.count, 1};
+
+    jobs.ParallelFor(span, RayGrain, [&](Span2D<RayHit> part, int start)
+    {
+        for (int i = 0; i < part.major; ++i)
+            part(i, 0) = Cast(grid, &occupancy, rays.data[start + i]);
+    });
+}
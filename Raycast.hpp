@@ -0,0 +1,75 @@
+#ifndef Raycast_hpp
+#define Raycast_hpp
+
+#include "Grid.hpp"
+#include "LineSegment.hpp"
+#include "Span.hpp"
+#include <vector>
+
+class JobSystem;
+
+/// Rays against the solid (foreground) tiles of a Grid, for line of sight,
+/// mining and lighting. Units are tiles, as in Collision.hpp. Rays are
+/// clipped to the grid; unlike collision, nothing outside it blocks.
+
+/// Side of the square chunks that TileOccupancy summarizes.
+constexpr int OccupancyChunkSize = 16;
+
+/// How many solid tiles each chunk holds, so a ray can cross a chunk of
+/// open air in one step. Compute once, then Update after each tile edit.
+class TileOccupancy
+{
+    Point<int> _chunkCount = {};
+    std::vector<uint16_t> _solidCounts;
+
+public:
+    void Compute(const Grid& grid);
+
+    /// Call after the tile at position changed.
+    void Update(const Grid& grid, Point<int> position);
+
+    inline bool IsEmpty(Point<int> chunk) const
+    {
+        return !_solidCounts[chunk.x * _chunkCount.y + chunk.y];
+    }
+};
+
+struct RayHit
+{
+    /// Fraction of the ray travelled before entering the tile; 1 means
+    /// nothing was hit.
+    float time = 1.0f;
+
+    /// Face the ray entered through, pointing back at its start. {0, 0}
+    /// when the ray starts inside the solid tile.
+    Point<int> normal = {0, 0};
+    Point<int> tile = {0, 0};
+    bool isHit = false;
+
+    /// Tiles tested on the way, for checking that casts stay cheap.
+    int visitedCount = 0;
+};
+
+/// Walks the tiles from ray.p1 to ray.p2 in order (Amanatides and Woo's
+/// DDA) and returns the first solid one. With occupancy, empty chunks are
+/// crossed without testing their tiles.
+RayHit CastRay(const Grid& grid, LineSegment<float> ray);
+RayHit CastRay(
+    const Grid& grid,
+    const TileOccupancy& occupancy,
+    LineSegment<float> ray);
+
+/// Casts every ray into the matching element of hits.
+void CastRays(
+    const Grid& grid,
+    const TileOccupancy& occupancy,
+    Span<const LineSegment<float>> rays,
+    Span<RayHit> hits);
+void CastRays(
+    JobSystem& jobs,
+    const Grid& grid,
+    const TileOccupancy& occupancy,
+    Span<const LineSegment<float>> rays,
+    Span<RayHit> hits);
+
+#endif
@@ -1,93 +1,141 @@
 #include "RenderGridBuffer.hpp"
 #include "Span.hpp"
-#include <utility>
+#include "Profile.hpp"
+#include "Metrics.hpp"
+#include <atomic>
 using namespace std;
 
-static pair<float, float> GetTexCoords(int index)
-{
-    int offset = index * 64;
+// Atomic so that chunks can be meshed on several threads at once.
+static atomic<uint32_t> theNextRevision{1};
 
-    return {
-        offset / 1024.0f,
-        (offset + 64) / 1024.0f};
-}
+static auto& theMeshesGenerated = RegisterCounter("meshes_generated");
+static auto& theMeshesReused = RegisterCounter("meshes_reused");
+static auto& theTilesMeshed = RegisterCounter("tiles_meshed");
+static auto& theQuadsMeshed = RegisterCounter("quads_meshed");
+
+/// Generations in a row that must produce a new mesh before it streams.
+static constexpr int StreamingRunLength = 3;
+
+/// Layers further back are drawn darker so they read as depth.
+static const float LayerShade[GridLayerCount] = {1.0f, 0.6f, 0.4f};
 
-void RenderGridBuffer::Generate(const Grid& source, Point<int> start, Point<int> size)
+void RenderGridBuffer::Generate(
+    const Grid& source,
+    const TextureAtlas& atlas,
+    const LightField& light,
+    Point<int> start,
+    Point<int> size)
 {
+    PROFILE_ZONE("RenderGridBuffer::Generate");
+
+    if (revision &&
+        source.revision == _sourceRevision &&
+        light.Revision() == _lightRevision &&
+        start == _start &&
+        size == _size)
+    {
+        theMeshesReused.Add();
+        _changedRunLength = 0;
+        streaming = false;
+        return;
+    }
+
+    if (_changedRunLength < StreamingRunLength) ++_changedRunLength;
+    streaming = _changedRunLength == StreamingRunLength;
+
+    revision = theNextRevision++;
+    _sourceRevision = source.revision;
+    _lightRevision = light.Revision();
+    _start = start;
+    _size = size;
+
     vertexData.clear();
     vertexData.reserve(1024);
+    quadCount = 0;
+    hiddenQuadCount = 0;
 
-    Span2D<const uint16_t> span;
-    span.major = source.size.x;
-    span.minor = source.size.y;
-    span.data = source.tiles.data();
+    Span2D<const uint16_t> layers[GridLayerCount];
+    for (int k = 0; k < GridLayerCount; ++k)
+    {
+        layers[k].major = source.size.x;
+        layers[k].minor = source.size.y;
+        layers[k].data = source.Layer(GridLayer(k)).data();
+    }
 
     for (int i = 0; i < size.x; ++i)
     {
         for (int j = 0; j < size.y; ++j)
         {
-            uint16_t tile = span(start.x + i, start.y + j);
-            if (tile == NoTile) continue;
-            int xi = tile & 0xf;
-            int yi = (tile >> 4) & 0xf;
-
-            auto tcs = GetTexCoords(xi);
-            auto tct = GetTexCoords(yi);
-
-            // I don't know how else to close the gaps.
-            constexpr float Lip = 1.0f / 1024.0f;
-            auto x = static_cast<float>(i) - Lip;
-            auto y = static_cast<float>(j) - Lip;
-            auto xx = static_cast<float>(i + 1) + Lip;
-            auto yy = static_cast<float>(j + 1) + Lip;
-
-            vertexData.push_back(x);
-            vertexData.push_back(y);
-            vertexData.push_back(tcs.first);
-            vertexData.push_back(tct.second);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-
-            vertexData.push_back(x);
-            vertexData.push_back(yy);
-            vertexData.push_back(tcs.first);
-            vertexData.push_back(tct.first);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-
-            vertexData.push_back(xx);
-            vertexData.push_back(yy);
-            vertexData.push_back(tcs.second);
-            vertexData.push_back(tct.first);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-
-            vertexData.push_back(x);
-            vertexData.push_back(y);
-            vertexData.push_back(tcs.first);
-            vertexData.push_back(tct.second);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-
-            vertexData.push_back(xx);
-            vertexData.push_back(yy);
-            vertexData.push_back(tcs.second);
-            vertexData.push_back(tct.first);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-
-            vertexData.push_back(xx);
-            vertexData.push_back(y);
-            vertexData.push_back(tcs.second);
-            vertexData.push_back(tct.second);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
-            vertexData.push_back(1.0f);
+            int sx = start.x + i;
+            int sy = start.y + j;
+
+            // Walk front to back until something opaque hides the rest.
+            int visibleCount = 0;
+            for (; visibleCount < GridLayerCount; ++visibleCount)
+            {
+                uint16_t tile = layers[visibleCount](sx, sy);
+                if (tile != NoTile && atlas.IsOpaque(tile)) break;
+            }
+
+            if (visibleCount < GridLayerCount)
+            {
+                for (int k = visibleCount + 1; k < GridLayerCount; ++k)
+                {
+                    if (layers[k](sx, sy) != NoTile) ++hiddenQuadCount;
+                }
+
+                ++visibleCount;
+            }
+
+            auto shade = float(light.Level(sx, sy)) / float(MaxLight);
+
+            for (int k = visibleCount - 1; k >= 0; --k)
+            {
+                uint16_t tile = layers[k](sx, sy);
+                if (tile == NoTile) continue;
+                PushQuad(
+                    i,
+                    j,
+                    atlas.Region(tile),
+                    shade * LayerShade[k],
+                    atlas.Animation(tile));
+                ++quadCount;
+            }
         }
     }
+
+    PROFILE_COUNTER("quads", quadCount);
+    theMeshesGenerated.Add();
+    theTilesMeshed.Add(int64_t(size.x) * size.y);
+    theQuadsMeshed.Add(quadCount);
+}
+
+void RenderGridBuffer::PushQuad(
+    int i,
+    int j,
+    const AtlasRegion& region,
+    float shade,
+    uint8_t animation)
+{
+    auto x = static_cast<float>(i);
+    auto y = static_cast<float>(j);
+    auto xx = static_cast<float>(i + 1);
+    auto yy = static_cast<float>(j + 1);
+
+    const float corners[6][4] = {
+        {x, y, region.s0, region.t1},
+        {x, yy, region.s0, region.t0},
+        {xx, yy, region.s1, region.t0},
+        {x, y, region.s0, region.t1},
+        {xx, yy, region.s1, region.t0},
+        {xx, y, region.s1, region.t1}};
+
+    for (auto& corner : corners)
+    {
+        vertexData.insert(vertexData.end(), corner, corner + 4);
+        vertexData.push_back(shade);
+        vertexData.push_back(shade);
+        vertexData.push_back(shade);
+        vertexData.push_back(float(animation));
+    }
 }
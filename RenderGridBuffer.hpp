@@ -3,13 +3,56 @@
 
 #include "Grid.hpp"
 #include "Matrix4x4.hpp"
+#include "TextureAtlas.hpp"
+#include "Lighting.hpp"
+
+/// Position (2), texture coordinates (2), color (3), animation slot (1).
+constexpr int VertexFloatCount = 8;
 
 struct RenderGridBuffer
 {
     Matrix4x4<float> matrix = Identity4x4<float>();
     std::vector<float> vertexData;
 
-    void Generate(const Grid& source, Point<int> start, Point<int> size);
+    /// Unique per generated mesh; zero until the first Generate. The
+    /// renderer compares it to decide whether its resident copy is stale.
+    uint32_t revision = 0;
+
+    /// Set while the mesh changes on every Generate, as it does while the
+    /// view pans, and cleared as soon as one is reused. Streaming meshes
+    /// are appended to the renderer's ring buffer instead of respecifying
+    /// a resident buffer for every new mesh.
+    bool streaming = false;
+
+    /// Quads in the last generated mesh, and quads a naive per-layer mesher
+    /// would have added for cells covered by an opaque tile in front.
+    size_t quadCount = 0;
+    size_t hiddenQuadCount = 0;
+
+    /// Meshes every layer of the visible cells in one traversal, back to
+    /// front within each cell so a single draw composites them correctly.
+    /// Animated tiles only record their animation slot; the vertex shader
+    /// advances the frame, so the mesh stays put while they animate.
+    void Generate(
+        const Grid& source,
+        const TextureAtlas& atlas,
+        const LightField& light,
+        Point<int> start,
+        Point<int> size);
+
+private:
+    void PushQuad(
+        int i,
+        int j,
+        const AtlasRegion& region,
+        float shade,
+        uint8_t animation);
+
+    int _changedRunLength = 0;
+    uint32_t _sourceRevision = 0;
+    uint32_t _lightRevision = 0;
+    Point<int> _start = {};
+    Point<int> _size = {};
 };
 
 #endif
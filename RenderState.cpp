@@ -0,0 +1,118 @@
+#include "RenderState.hpp"
+#include <cassert>
+
+RenderState::RenderState()
+{
+    Invalidate();
+}
+
+void RenderState::Invalidate()
+{
+    _program = 0;
+    _arrayBuffer = 0;
+    _vertexArray = 0;
+    _texture = 0;
+    _activeTexture = GL_TEXTURE0;
+    _blendSource = GL_ONE;
+    _blendDestination = GL_ZERO;
+    _enabledAttributes = 0;
+    _blend = false;
+    _texture2D = false;
+}
+
+void RenderState::UseProgram(GLuint program)
+{
+    if (Skip(program == _program)) return;
+    glUseProgram(program);
+    _program = program;
+}
+
+void RenderState::BindArrayBuffer(GLuint buffer)
+{
+    if (Skip(buffer == _arrayBuffer)) return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    _arrayBuffer = buffer;
+}
+
+void RenderState::BindVertexArray(GLuint vertexArray)
+{
+    if (Skip(vertexArray == _vertexArray)) return;
+#ifndef KerrariaES2
+    glBindVertexArray(vertexArray);
+#endif
+    _vertexArray = vertexArray;
+}
+
+void RenderState::BindTexture2D(GLenum unit, GLuint texture)
+{
+    if (!Skip(unit == _activeTexture))
+    {
+        glActiveTexture(unit);
+        _activeTexture = unit;
+        _texture = 0;
+    }
+
+    // Only one unit is in use, so a single binding slot is enough.
+    if (Skip(texture == _texture)) return;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    _texture = texture;
+}
+
+void RenderState::SetBlend(bool enabled)
+{
+    if (Skip(enabled == _blend)) return;
+    if (enabled) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+    _blend = enabled;
+}
+
+void RenderState::SetBlendFunc(GLenum source, GLenum destination)
+{
+    if (Skip(source == _blendSource && destination == _blendDestination))
+        return;
+
+    glBlendFunc(source, destination);
+    _blendSource = source;
+    _blendDestination = destination;
+}
+
+void RenderState::SetTexture2D(bool enabled)
+{
+#ifdef KerrariaES2
+    // Fixed-function enable; not a valid capability in ES2.
+    (void)enabled;
+#else
+    if (Skip(enabled == _texture2D)) return;
+    if (enabled) glEnable(GL_TEXTURE_2D); else glDisable(GL_TEXTURE_2D);
+    _texture2D = enabled;
+#endif
+}
+
+void RenderState::EnableAttribute(GLint attribute)
+{
+    assert(_vertexArray == 0);
+    if (attribute < 0) return;
+    assert(attribute < MaxAttributes);
+
+    unsigned bit = 1u << attribute;
+    if (Skip(_enabledAttributes & bit)) return;
+    glEnableVertexAttribArray(attribute);
+    _enabledAttributes |= bit;
+}
+
+void RenderState::DisableAttribute(GLint attribute)
+{
+    assert(_vertexArray == 0);
+    if (attribute < 0) return;
+    assert(attribute < MaxAttributes);
+
+    unsigned bit = 1u << attribute;
+    if (Skip(!(_enabledAttributes & bit))) return;
+    glDisableVertexAttribArray(attribute);
+    _enabledAttributes &= ~bit;
+}
+
+void RenderState::ResetCounts()
+{
+    _callCount = 0;
+    _skippedCallCount = 0;
+}
@@ -0,0 +1,65 @@
+#ifndef RenderState_hpp
+#define RenderState_hpp
+
+#include "OpenGL.hpp"
+
+/// Shadow copy of the GL state the renderer touches. Each setter only
+/// reaches the driver when the value actually changes, so consecutive
+/// draws and layers can share one setup. Every call that does reach GL is
+/// counted in software, which keeps the counter meaningful under
+/// software rasterizers that expose no timer queries.
+///
+/// The tracker assumes it is the only code changing this state. Anything
+/// that goes around it must call Invalidate afterward.
+class RenderState
+{
+    static constexpr int MaxAttributes = 16;
+
+    GLuint _program;
+    GLuint _arrayBuffer;
+    GLuint _vertexArray;
+    GLuint _texture;
+    GLenum _activeTexture;
+    GLenum _blendSource;
+    GLenum _blendDestination;
+    unsigned _enabledAttributes;
+    bool _blend;
+    bool _texture2D;
+    int _callCount = 0;
+    int _skippedCallCount = 0;
+
+    inline bool Skip(bool same)
+    {
+        if (same) ++_skippedCallCount;
+        else ++_callCount;
+        return same;
+    }
+
+public:
+    RenderState();
+
+    /// Forgets everything and assumes GL defaults.
+    void Invalidate();
+
+    void UseProgram(GLuint program);
+    void BindArrayBuffer(GLuint buffer);
+    void BindVertexArray(GLuint vertexArray);
+    void BindTexture2D(GLenum unit, GLuint texture);
+    void SetBlend(bool enabled);
+    void SetBlendFunc(GLenum source, GLenum destination);
+    void SetTexture2D(bool enabled);
+
+    /// Attribute enables belong to the bound vertex array; these track the
+    /// default one (zero) only.
+    void EnableAttribute(GLint attribute);
+    void DisableAttribute(GLint attribute);
+
+    /// Records GL calls made outside the tracker, such as draws.
+    inline void Count(int calls = 1) { _callCount += calls; }
+
+    inline int CallCount() const { return _callCount; }
+    inline int SkippedCallCount() const { return _skippedCallCount; }
+    void ResetCounts();
+};
+
+#endif
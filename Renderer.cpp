@@ -1,16 +1,35 @@
 #include "Renderer.hpp"
 #include "Debug.hpp"
-#include <SDL_image.h>
+#include "Profile.hpp"
+#include "Metrics.hpp"
+#include "AssetBundle.hpp"
+#include "ProgramCache.hpp"
+#include <SDL.h>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 using namespace std;
 
-static constexpr auto PixelFormat = SDL_PIXELFORMAT_ABGR8888;
+static constexpr GLsizei Stride = sizeof(GLfloat) * VertexFloatCount;
+static constexpr GLsizeiptr StreamCapacity = 1 << 20;
+#ifdef KerrariaES2
+static constexpr const char* VertexShaderPath = "es2.vertex.shader";
+static constexpr const char* FragmentShaderPath = "es2.fragment.shader";
+#else
+static constexpr const char* VertexShaderPath = "vertex.shader";
+static constexpr const char* FragmentShaderPath = "fragment.shader";
+#endif
+static constexpr const char* SheetPath = "images/sheet.png";
+static auto& theVertexBytesUploaded = RegisterCounter("vertex_bytes_uploaded");
+static auto& theVertexBytesStreamed = RegisterCounter("vertex_bytes_streamed");
+static auto& theVerticesDrawn = RegisterCounter("vertices_drawn");
+static auto& theResidentMeshes = RegisterGauge("resident_meshes");
+
 static const GLenum TexParams[] = {
     GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE,
     GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE,
     GL_TEXTURE_MAG_FILTER, GL_NEAREST,
-    GL_TEXTURE_MIN_FILTER, GL_NEAREST,
+    GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR,
     0, 0 };
 
 static void SetParams(const GLenum* params)
@@ -19,49 +38,127 @@ static void SetParams(const GLenum* params)
         glTexParameteri(GL_TEXTURE_2D, params[i], params[i + 1]);
 }
 
-static void LoadTexture(const char* path)
+/// Returns how many of the mip levels should be uploaded.
+static int UsableLevelCount(int levelCount, int maxCleanLevel)
+{
+#ifndef KerrariaES2
+    // Past this level the gutters are gone and cells bleed together. ES2
+    // has no GL_TEXTURE_MAX_LEVEL and needs the whole chain instead.
+    levelCount = Min(levelCount, maxCleanLevel + 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levelCount - 1);
+#else
+    (void)maxCleanLevel;
+#endif
+    return levelCount;
+}
+
+static void UploadLevel(int level, int width, int height, const void* pixels)
+{
+    glTexImage2D(
+        GL_TEXTURE_2D,
+        level,
+        GL_RGBA,
+        width,
+        height,
+        0,
+        GL_RGBA,
+        GL_UNSIGNED_BYTE,
+        pixels);
+}
+
+static void LoadAtlasFromFile(TextureAtlas& atlas, const char* path)
 {
-    auto surface = IMG_Load(path);
+    auto sheet = LoadImage(path);
+    atlas = PackAtlas(
+        SliceSheet(sheet, TileSheetCellSize),
+        TileAtlasGutter,
+        TileSheetAnimations);
+
+    int levelCount = UsableLevelCount(
+        atlas.mipLevels.size(),
+        atlas.maxCleanLevel);
 
-    if (surface)
+    for (int i = 0; i < levelCount; ++i)
     {
-        if (surface->format->format != PixelFormat)
-        {
-            Log() << "Converting format for " << path << '\n';
-            auto convertedSurface = SDL_ConvertSurfaceFormat(
-                surface,
-                PixelFormat,
-                0);
-
-            SDL_FreeSurface(surface);
-            surface = convertedSurface;
-        }
+        const auto& level = atlas.mipLevels[i];
+        UploadLevel(i, level.width, level.height, level.pixels.data());
+    }
 
-        if (surface)
-        {
-            Log() << "Loaded " << path << " successfully!\n";
-            glTexImage2D(
-                GL_TEXTURE_2D,
-                0,
-                GL_RGBA,
-                surface->w,
-                surface->h,
-                0,
-                GL_RGBA,
-                GL_UNSIGNED_BYTE,
-                surface->pixels);
-        }
-        else
-        {
-            Log() << "Failed to convert image format for " << path << '\n';
-        }
+    if (levelCount > 0)
+    {
+        LOG_INFO << "Packed " << path << " into a "
+            << atlas.mipLevels[0].width << "x" << atlas.mipLevels[0].height
+            << " atlas with " << levelCount << " mip levels\n";
+    }
+
+    // The pixels live on the GPU now; only the region table is needed.
+    atlas.mipLevels.clear();
+    atlas.mipLevels.shrink_to_fit();
+}
 
-        SDL_FreeSurface(surface);
+/// Uploads the baked mip levels straight out of the mapped bundle.
+static bool LoadAtlasFromBundle(
+    TextureAtlas& atlas,
+    const AssetBundle& bundle)
+{
+    auto infoBlob = bundle.Find("atlas.info");
+    auto regionBlob = bundle.Find("atlas.regions");
+    auto opaqueBlob = bundle.Find("atlas.opaque");
+    auto animationBlob = bundle.Find("atlas.animation");
+    auto animationsBlob = bundle.Find("atlas.animations");
+    auto idCount = regionBlob.count / sizeof(AtlasRegion);
+
+    BundleAtlasInfo info;
+    if (infoBlob.count != sizeof(info) ||
+        regionBlob.count % sizeof(AtlasRegion) ||
+        size_t(opaqueBlob.count) != idCount ||
+        size_t(animationBlob.count) != idCount ||
+        animationsBlob.count % sizeof(AtlasAnimation))
+    {
+        return false;
     }
-    else
+
+    memcpy(&info, infoBlob.data, sizeof(info));
+
+    int levelCount = UsableLevelCount(info.levelCount, info.maxCleanLevel);
+
+    for (int i = 0; i < levelCount; ++i)
     {
-        Log() << "Failed to load image " << path << '\n';
+        auto name = "atlas.level." + to_string(i);
+        auto blob = bundle.Find(name.c_str());
+
+        BundleImageHeader header;
+        if (blob.count < int(sizeof(header))) return false;
+        memcpy(&header, blob.data, sizeof(header));
+
+        auto pixelSize = size_t(header.width) * header.height * 4;
+        if (blob.count - sizeof(header) < pixelSize) return false;
+
+        UploadLevel(
+            i,
+            header.width,
+            header.height,
+            blob.data + sizeof(header));
     }
+
+    atlas.maxCleanLevel = info.maxCleanLevel;
+    atlas.regions.resize(idCount);
+    memcpy(atlas.regions.data(), regionBlob.data, regionBlob.count);
+    atlas.opaque.assign(
+        opaqueBlob.data,
+        opaqueBlob.data + opaqueBlob.count);
+    atlas.animation.assign(
+        animationBlob.data,
+        animationBlob.data + animationBlob.count);
+    atlas.animations.resize(animationsBlob.count / sizeof(AtlasAnimation));
+    memcpy(
+        atlas.animations.data(),
+        animationsBlob.data,
+        animationsBlob.count);
+
+    LOG_INFO << "Loaded atlas with " << levelCount
+        << " mip levels from bundle\n";
+    return true;
 }
 
 static GLuint LoadShader(const char* source, GLenum shaderType)
@@ -82,11 +179,11 @@ static GLuint LoadShader(const char* source, GLenum shaderType)
         errors.resize(length);
         glGetShaderInfoLog(shader, length, &length, &errors[0]);
 
-        Log() << "-- shader compilation errors --\n" << errors << '\n';
+        LOG_ERROR << "-- shader compilation errors --\n" << errors << '\n';
     }
     else
     {
-        Log() << "successfully compiled shader\n";
+        LOG_DEBUG << "successfully compiled shader\n";
     }
 
     return shader;
@@ -105,6 +202,7 @@ static GLuint LoadProgram(
 
     glAttachShader(program, vertexShader);
     glAttachShader(program, fragmentShader);
+    PrepareProgramBinary(program);
     glLinkProgram(program);
 
     GLint isLinked;
@@ -118,11 +216,11 @@ static GLuint LoadProgram(
         errors.resize(length);
         glGetProgramInfoLog(program, length, &length, &errors[0]);
 
-        Log() << "-- program linker errors --\n" << errors << '\n';
+        LOG_ERROR << "-- program linker errors --\n" << errors << '\n';
     }
     else
     {
-        Log() << "successfully linked shader program\n";
+        LOG_DEBUG << "successfully linked shader program\n";
     }
 
     glDeleteShader(fragmentShader);
@@ -131,6 +229,36 @@ static GLuint LoadProgram(
     return program;
 }
 
+/// Same as LoadProgram, but tries the on-disk program binary cache first
+/// and refills it after a miss.
+static GLuint LoadCachedProgram(
+    const char* vertexShaderSource,
+    const char* fragmentShaderSource)
+{
+    auto start = SDL_GetPerformanceCounter();
+    auto key = ProgramKey(vertexShaderSource, fragmentShaderSource);
+
+    GLuint program = glCreateProgram();
+    bool isCached = LoadProgramBinary(program, key);
+
+    if (!isCached)
+    {
+        glDeleteProgram(program);
+        program = LoadProgram(vertexShaderSource, fragmentShaderSource);
+
+        GLint isLinked;
+        glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+        if (isLinked) SaveProgramBinary(program, key);
+    }
+
+    auto elapsed = SDL_GetPerformanceCounter() - start;
+    LOG_INFO << "Shader setup took "
+        << (double(elapsed) * 1000.0 / double(SDL_GetPerformanceFrequency()))
+        << " ms (program cache " << (isCached ? "hit" : "miss") << ")\n";
+
+    return program;
+}
+
 static string FileToString(const char* path)
 {
     string result;
@@ -158,68 +286,188 @@ static GLuint LoadProgramFromFiles(
     string vertexShaderSource = FileToString(vertexShaderPath);
     string fragmentShaderSource = FileToString(fragmentShaderPath);
 
-    return LoadProgram(
+    return LoadCachedProgram(
         vertexShaderSource.c_str(),
         fragmentShaderSource.c_str());
 }
 
-Renderer::Renderer()
+/// Returns zero if the bundle lacks either source.
+static GLuint LoadProgramFromBundle(
+    const AssetBundle& bundle,
+    const char* vertexShaderPath,
+    const char* fragmentShaderPath)
+{
+    auto vertexShader = bundle.Find(vertexShaderPath);
+    auto fragmentShader = bundle.Find(fragmentShaderPath);
+
+    // Baked sources carry their terminator.
+    if (vertexShader.count < 1 ||
+        fragmentShader.count < 1 ||
+        vertexShader.data[vertexShader.count - 1] ||
+        fragmentShader.data[fragmentShader.count - 1])
+    {
+        return 0;
+    }
+
+    return LoadCachedProgram(
+        reinterpret_cast<const char*>(vertexShader.data),
+        reinterpret_cast<const char*>(fragmentShader.data));
+}
+
+static bool HasVertexArrays()
 {
-    _program = LoadProgramFromFiles(
 #ifdef KerrariaES2
-        "es2.vertex.shader",
-        "es2.fragment.shader");
+    return false;
 #else
-        "vertex.shader",
-        "fragment.shader");
+    return GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object;
 #endif
+}
+
+/// Milliseconds after which every animation is back on its first frame.
+/// The shader time wraps at this, so it stays small enough for floats.
+static uint32_t AnimationCycle(const vector<AtlasAnimation>& animations)
+{
+    uint32_t result = 1;
+
+    for (const auto& animation : animations)
+    {
+        uint32_t period = uint32_t(animation.frameCount) *
+            animation.frameMilliseconds;
+        if (!period) continue;
+
+        // Least common multiple with the periods so far.
+        uint32_t a = result;
+        uint32_t b = period;
+        while (b)
+        {
+            auto remainder = a % b;
+            a = b;
+            b = remainder;
+        }
+
+        result = result / a * period;
+    }
+
+    return result;
+}
+
+Renderer::Renderer()
+    : _stream(StreamCapacity)
+    , _hasVertexArrays(HasVertexArrays())
+{
+    auto loadStart = SDL_GetPerformanceCounter();
+
+    AssetBundle bundle;
+    bool hasBundle = bundle.Open(BundlePath);
+    const char* programSource = "loose files";
+    const char* atlasSource = "loose files";
+    _program = 0;
+
+    // A loose file edited since the last bake wins over its baked copy.
+    auto isFresh = [&](const char* path)
+    {
+        if (!bundle.IsStale(path)) return true;
+
+        LOG_WARNING << path << " changed since " << BundlePath
+            << " was baked; loading the loose file. Run make bake to "
+            << "update the bundle.\n";
+        return false;
+    };
+
+    if (hasBundle && isFresh(VertexShaderPath) && isFresh(FragmentShaderPath))
+    {
+        _program = LoadProgramFromBundle(
+            bundle,
+            VertexShaderPath,
+            FragmentShaderPath);
+        if (_program) programSource = BundlePath;
+    }
+
+    if (!_program)
+    {
+        _program = LoadProgramFromFiles(
+            VertexShaderPath,
+            FragmentShaderPath);
+    }
 
     _matrixUniform = glGetUniformLocation(_program, "theMatrix");
     _textureUniform = glGetUniformLocation(_program, "theTexture");
+    _timeUniform = glGetUniformLocation(_program, "theTime");
+    _animationsUniform = glGetUniformLocation(_program, "theAnimations");
     _positionAttribute = glGetAttribLocation(_program, "position");
     _colorAttribute = glGetAttribLocation(_program, "color");
     _textureCoordinateAttribute = glGetAttribLocation(_program, "textureCoordinates");
+    _animationAttribute = glGetAttribLocation(_program, "animation");
+
+    // Uniforms live in the program object, so the sampler only needs
+    // setting once.
+    _state.UseProgram(_program);
+    glUniform1i(_textureUniform, 0);
 
-    glEnable(GL_TEXTURE_2D);
     glGenTextures(1, &_texture);
-    glBindTexture(GL_TEXTURE_2D, _texture);
+    _state.BindTexture2D(GL_TEXTURE0, _texture);
     SetParams(TexParams);
-    LoadTexture("images/sheet.png");
-    glDisable(GL_TEXTURE_2D);
-}
 
-Renderer::~Renderer()
-{
-    glDeleteTextures(1, &_texture);
-    glDeleteProgram(_program);
-}
+    if (hasBundle && isFresh(SheetPath) && LoadAtlasFromBundle(_atlas, bundle))
+        atlasSource = BundlePath;
+    else
+        LoadAtlasFromFile(_atlas, SheetPath);
 
-void Renderer::Render(const RenderGridBuffer& buffer)
-{
-    // --- Open() ---
+    // Slot 0 and any unused slots hold a single still frame.
+    GLfloat animations[MaxAtlasAnimations * 3] = {};
+    for (int i = 0; i < MaxAtlasAnimations; ++i) animations[i * 3] = 1.0f;
+
+    for (size_t i = 0; i < _atlas.animations.size(); ++i)
+    {
+        const auto& animation = _atlas.animations[i];
+        auto slot = animations + (i + 1) * 3;
+        slot[0] = float(animation.frameCount);
+        slot[1] = 1000.0f / float(Max<int>(animation.frameMilliseconds, 1));
+        slot[2] = animation.step;
+    }
+
+    glUniform3fv(_animationsUniform, MaxAtlasAnimations, animations);
+    _animationCycle = AnimationCycle(_atlas.animations);
 
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
-    glUseProgram(_program);
+    auto loadTime = SDL_GetPerformanceCounter() - loadStart;
+    LOG_INFO << "Loaded shaders from " << programSource
+        << " and the atlas from " << atlasSource << " in "
+        << (double(loadTime) * 1000.0 / double(SDL_GetPerformanceFrequency()))
+        << " ms\n";
+}
 
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnableVertexAttribArray(_positionAttribute);
-    glEnableVertexAttribArray(_colorAttribute);
-    glEnableVertexAttribArray(_textureCoordinateAttribute);
+Renderer::~Renderer()
+{
+    theResidentMeshes.Set(0);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, _texture);
-    glUniform1i(_textureUniform, 0);
-    glUniformMatrix4fv(_matrixUniform, 1, GL_FALSE, buffer.matrix);
+    for (auto& mesh : _meshes)
+    {
+#ifndef KerrariaES2
+        if (mesh.vertexArray) glDeleteVertexArrays(1, &mesh.vertexArray);
+#endif
+        glDeleteBuffers(1, &mesh.vertexBuffer);
+    }
 
-    // --- Render() ---
+    _state.UseProgram(0);
+    glDeleteTextures(1, &_texture);
+    glDeleteProgram(_program);
+}
 
-    glClear(GL_COLOR_BUFFER_BIT);
+void Renderer::EnableAttributes()
+{
+    _state.EnableAttribute(_positionAttribute);
+    _state.EnableAttribute(_colorAttribute);
+    _state.EnableAttribute(_textureCoordinateAttribute);
+    _state.EnableAttribute(_animationAttribute);
+}
 
-    constexpr auto Stride = sizeof(GLfloat) * 7;
-    auto data = buffer.vertexData.data();
+/// Points the attributes at the currently bound GL_ARRAY_BUFFER, with base
+/// being the byte offset of the first vertex.
+void Renderer::SetAttributePointers(const GLvoid* base)
+{
+    auto data = static_cast<const GLfloat*>(base);
 
     glVertexAttribPointer(
         _positionAttribute,
@@ -242,16 +490,174 @@ void Renderer::Render(const RenderGridBuffer& buffer)
         GL_FALSE,
         Stride,
         data + 4);
+    glVertexAttribPointer(
+        _animationAttribute,
+        1,
+        GL_FLOAT,
+        GL_FALSE,
+        Stride,
+        data + 7);
+
+    _state.Count(4);
+}
+
+/// Only used without vertex arrays. Skips re-pointing the attributes when
+/// the previous draw already used the same buffer and offset.
+void Renderer::PointAttributesAt(GLuint buffer, GLintptr offset)
+{
+    _state.BindVertexArray(0);
+    _state.BindArrayBuffer(buffer);
+    EnableAttributes();
+
+    if (buffer != _pointerBuffer || offset != _pointerOffset)
+    {
+        SetAttributePointers(reinterpret_cast<const GLvoid*>(offset));
+        _pointerBuffer = buffer;
+        _pointerOffset = offset;
+    }
+}
+
+Renderer::ResidentMesh& Renderer::FindMesh(const RenderGridBuffer& buffer)
+{
+    for (auto& mesh : _meshes)
+    {
+        if (mesh.source == &buffer) return mesh;
+    }
+
+    ResidentMesh mesh;
+    mesh.source = &buffer;
+    glGenBuffers(1, &mesh.vertexBuffer);
+
+#ifndef KerrariaES2
+    if (_hasVertexArrays)
+    {
+        // The layout never changes, so capture it once per mesh. The
+        // enables are part of the vertex array, hence the raw calls.
+        glGenVertexArrays(1, &mesh.vertexArray);
+        _state.BindVertexArray(mesh.vertexArray);
+        _state.BindArrayBuffer(mesh.vertexBuffer);
+        glEnableVertexAttribArray(_positionAttribute);
+        glEnableVertexAttribArray(_colorAttribute);
+        glEnableVertexAttribArray(_textureCoordinateAttribute);
+        glEnableVertexAttribArray(_animationAttribute);
+        _state.Count(4);
+        SetAttributePointers(nullptr);
+    }
+#endif
+
+    _meshes.push_back(mesh);
+    theResidentMeshes.Set(int64_t(_meshes.size()));
+    return _meshes.back();
+}
+
+GLsizeiptr Renderer::Upload(ResidentMesh& mesh, const RenderGridBuffer& buffer)
+{
+    if (mesh.revision == buffer.revision) return 0;
+
+    GLsizeiptr size = buffer.vertexData.size() * sizeof(GLfloat);
+
+    // Respecifying the whole store lets the driver orphan the old one if
+    // the GPU is still drawing from it.
+    _state.BindArrayBuffer(mesh.vertexBuffer);
+    glBufferData(
+        GL_ARRAY_BUFFER,
+        size,
+        buffer.vertexData.data(),
+        GL_STATIC_DRAW);
+    _state.Count();
+
+    mesh.revision = buffer.revision;
+    return size;
+}
+
+void Renderer::BeginFrame()
+{
+    _stats.callCount += _state.CallCount();
+    _stats.skippedCallCount += _state.SkippedCallCount();
+    _state.ResetCounts();
+    ++_stats.frameCount;
+    _frameByteCount = 0;
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    _state.Count();
+
+    // Animated tiles advance here, in one uniform, instead of remeshing.
+    auto time = float(SDL_GetTicks() % _animationCycle) / 1000.0f;
+    if (time != _time)
+    {
+        _state.UseProgram(_program);
+        glUniform1f(_timeUniform, time);
+        _state.Count();
+        _time = time;
+    }
+}
+
+void Renderer::Draw(const RenderGridBuffer& buffer)
+{
+    _state.UseProgram(_program);
+    _state.SetTexture2D(true);
+    _state.SetBlend(true);
+    _state.SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    _state.BindTexture2D(GL_TEXTURE0, _texture);
 
-    glDrawArrays(GL_TRIANGLES, 0, buffer.vertexData.size() / 7);
+    if (!_hasMatrix || buffer.matrix != _matrix)
+    {
+        glUniformMatrix4fv(_matrixUniform, 1, GL_FALSE, buffer.matrix);
+        _state.Count();
+        _matrix = buffer.matrix;
+        _hasMatrix = true;
+    }
+
+    GLsizei vertexCount = buffer.vertexData.size() / VertexFloatCount;
+    if (vertexCount < 1) return;
 
-    // --- Close() ---
+    GLsizeiptr bytes = 0;
 
-    glDisableVertexAttribArray(_textureCoordinateAttribute);
-    glDisableVertexAttribArray(_colorAttribute);
-    glDisableVertexAttribArray(_positionAttribute);
-    glDisable(GL_BLEND);
-    glDisable(GL_TEXTURE_2D);
+    if (buffer.streaming)
+    {
+        GLsizeiptr size = buffer.vertexData.size() * sizeof(GLfloat);
+        auto offset = _stream.Write(_state, buffer.vertexData.data(), size);
+        theVertexBytesStreamed.Add(size);
+        bytes += size;
+
+        PointAttributesAt(_stream.Buffer(), offset);
+    }
+    else
+    {
+        auto& mesh = FindMesh(buffer);
+        bytes += Upload(mesh, buffer);
+
+        if (mesh.vertexArray)
+            _state.BindVertexArray(mesh.vertexArray);
+        else
+            PointAttributesAt(mesh.vertexBuffer, 0);
+    }
 
-    glUseProgram(0);
+    glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+    _state.Count();
+
+    theVertexBytesUploaded.Add(bytes);
+    theVerticesDrawn.Add(vertexCount);
+    _stats.byteCount += bytes;
+    _frameByteCount += bytes;
+    if (_frameByteCount > _stats.peakFrameByteCount)
+        _stats.peakFrameByteCount = _frameByteCount;
+}
+
+void Renderer::Render(const RenderGridBuffer& buffer)
+{
+    PROFILE_ZONE("Renderer::Render");
+    BeginFrame();
+    Draw(buffer);
+}
+
+RenderStats Renderer::TakeStats()
+{
+    _stats.callCount += _state.CallCount();
+    _stats.skippedCallCount += _state.SkippedCallCount();
+    _state.ResetCounts();
+
+    auto result = _stats;
+    _stats = RenderStats();
+    return result;
 }
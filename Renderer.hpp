@@ -3,16 +3,72 @@
 
 #include "OpenGL.hpp"
 #include "RenderGridBuffer.hpp"
+#include "RenderState.hpp"
+#include "TextureAtlas.hpp"
+#include "VertexStream.hpp"
+#include <vector>
+
+struct RenderStats
+{
+    int frameCount = 0;
+    GLsizeiptr byteCount = 0;
+    GLsizeiptr peakFrameByteCount = 0;
+    int callCount = 0;
+    int skippedCallCount = 0;
+
+    RenderStats& operator+=(const RenderStats& other)
+    {
+        frameCount += other.frameCount;
+        byteCount += other.byteCount;
+        if (other.peakFrameByteCount > peakFrameByteCount)
+            peakFrameByteCount = other.peakFrameByteCount;
+        callCount += other.callCount;
+        skippedCallCount += other.skippedCallCount;
+        return *this;
+    }
+};
 
 class Renderer
 {
+    /// GPU-resident copy of a non-streaming RenderGridBuffer. It is only
+    /// re-uploaded when the source's revision moves.
+    struct ResidentMesh
+    {
+        const RenderGridBuffer* source = nullptr;
+        uint32_t revision = 0;
+        GLuint vertexBuffer = 0;
+        GLuint vertexArray = 0;
+    };
+
+    RenderState _state;
+    VertexStream _stream;
+    std::vector<ResidentMesh> _meshes;
+    TextureAtlas _atlas;
+    RenderStats _stats;
+    GLsizeiptr _frameByteCount = 0;
+    Matrix4x4<float> _matrix;
+    uint32_t _animationCycle = 1;
+    float _time = -1.0f;
+    GLuint _pointerBuffer = 0;
+    GLintptr _pointerOffset = -1;
+    bool _hasMatrix = false;
+    bool _hasVertexArrays;
     GLuint _texture;
     GLuint _program;
 	GLint _matrixUniform;
     GLint _textureUniform;
+    GLint _timeUniform;
+    GLint _animationsUniform;
     GLint _positionAttribute;
     GLint _colorAttribute;
     GLint _textureCoordinateAttribute;
+    GLint _animationAttribute;
+
+    void EnableAttributes();
+    void SetAttributePointers(const GLvoid* base);
+    void PointAttributesAt(GLuint buffer, GLintptr offset);
+    ResidentMesh& FindMesh(const RenderGridBuffer& buffer);
+    GLsizeiptr Upload(ResidentMesh& mesh, const RenderGridBuffer& buffer);
 
 public:
     Renderer();
@@ -23,7 +79,18 @@ public:
     Renderer& operator=(Renderer&&) = delete;
     Renderer& operator=(const Renderer&) = delete;
 
+    inline const TextureAtlas& Atlas() const { return _atlas; }
+
+    /// Clears the frame and advances tile animations. Any number of Draw
+    /// calls may follow; they share whatever GL state is already in place.
+    void BeginFrame();
+    void Draw(const RenderGridBuffer& buffer);
+
+    /// BeginFrame followed by a single Draw.
     void Render(const RenderGridBuffer& buffer);
+
+    /// Returns counters accumulated since the previous call.
+    RenderStats TakeStats();
 };
 
 #endif
@@ -1,17 +1,26 @@
 #include "TestHandler.hpp"
 #include "Debug.hpp"
+#include "Profile.hpp"
+#include "Raycast.hpp"
 #include <fstream>
 #include <sstream>
-#include <ctime>
 using namespace std;
 
 static constexpr float Delta = 1.0f / 8.0f;
 static constexpr float PixelsPerSpace = 64.0f;
 
-TestHandler::TestHandler()
-    : _mt(time(nullptr))
+/// Where the T key writes the profile trace, and how far back it goes.
+static constexpr const char* TracePath = "trace.json";
+static constexpr double TraceSeconds = 10.0;
+
+/// How far from the view center, in tiles, right click can mine.
+static constexpr float MiningReach = 8.0f;
+
+TestHandler::TestHandler(uint32_t seed)
+    : _mt(seed)
 {
     _grid = GenerateSimple({256, 128}, _mt);
+    _light.Compute(_grid);
     
     _tileViewCenter = {
         static_cast<float>(_grid.size.x / 2),
@@ -24,10 +33,24 @@ TestHandler::~TestHandler()
 
 void TestHandler::OnOpen()
 {
+    if (Window())
+    {
+        _renderer.reset(new Renderer);
+    }
+    else
+    {
+        _atlas = PackAtlas(
+            SliceSheet(LoadImage("images/sheet.png"), TileSheetCellSize),
+            TileAtlasGutter,
+            TileSheetAnimations);
+        _atlas.mipLevels.clear();
+    }
 }
 
 void TestHandler::OnClose()
 {
+    // The renderer's GL objects must go while the context is current.
+    _renderer.reset();
 }
 
 void TestHandler::OnPrepareRender()
@@ -45,7 +68,13 @@ void TestHandler::OnPrepareRender()
             0,
             _grid.size.y - _tileViewSize.y);
     
-    _buffer.Generate(_grid, tileViewOffset, _tileViewSize);
+    auto& buffer = _buffers[PrepareSlot()];
+    buffer.Generate(
+        _grid,
+        Atlas(),
+        _light,
+        tileViewOffset,
+        _tileViewSize);
 
     auto translation = -center + tileViewOffset.Cast<float>();
 
@@ -56,20 +85,25 @@ void TestHandler::OnPrepareRender()
             translation.y,
             0.0f);
     
-    _buffer.matrix = _projectionMatrix * _rotateMatrix;
+    buffer.matrix = _projectionMatrix * _rotateMatrix;
 
     if (_logDump)
     {
         _logDump = false;
-        Log() << "halfSpace -- " << halfSpace << '\n';
-        Log() << "center -- " << center << '\n';
-        Log() << "translation -- " << translation << '\n';
+        LOG_DEBUG << "halfSpace -- " << halfSpace << '\n';
+        LOG_DEBUG << "center -- " << center << '\n';
+        LOG_DEBUG << "translation -- " << translation << '\n';
     }
 }
 
 void TestHandler::OnRender()
 {
-    _renderer.Render(_buffer);
+    _renderer->Render(_buffers[RenderSlot()]);
+
+    // The renderer may live on the render thread; hand its counters over
+    // for OnSecond.
+    lock_guard<mutex> lock(_statsMutex);
+    _renderStats += _renderer->TakeStats();
 }
 
 void TestHandler::OnUpdate()
@@ -78,6 +112,33 @@ void TestHandler::OnUpdate()
     _rotation -= (1.0f / 128.0f);
 }
 
+void TestHandler::OnSecond()
+{
+    WindowEventHandler::OnSecond();
+    RenderStats stats;
+
+    {
+        lock_guard<mutex> lock(_statsMutex);
+        stats = _renderStats;
+        _renderStats = RenderStats();
+    }
+
+    if (_logStats)
+    {
+        LOG_INFO << stats.byteCount << " bytes uploaded over "
+            << stats.frameCount << " frames (peak "
+            << stats.peakFrameByteCount << " bytes per frame)\n";
+
+        if (stats.frameCount > 0)
+        {
+            LOG_INFO << (stats.callCount / stats.frameCount)
+                << " GL calls per frame ("
+                << (stats.skippedCallCount / stats.frameCount)
+                << " redundant calls skipped)\n";
+        }
+    }
+}
+
 void TestHandler::OnKeyDown(SDL_Keysym keysym)
 {
     WindowEventHandler::OnKeyDown(keysym);
@@ -87,6 +148,10 @@ void TestHandler::OnKeyDown(SDL_Keysym keysym)
             _logStats = !_logStats;
             break;
 
+        case SDLK_t:
+            WriteProfileTrace(TracePath, TraceSeconds);
+            break;
+
         case SDLK_BACKSLASH:
             //SDL_Delay(750);
             _logDump = true;
@@ -198,18 +263,23 @@ void TestHandler::OnMouseButtonDown(SDL_MouseButtonEvent event)
         Point<int> position = {event.x, _displaySize.y - 1 - event.y};
         auto halfSpace = _tileViewSpace / 2.0f;
         auto spaceOffset = position.Cast<float>() / PixelsPerSpace - halfSpace;
-        auto worldCoordinates = (_tileViewCenter + spaceOffset).Cast<int>();
-        
-        if (worldCoordinates.x >= 0 &&
-            worldCoordinates.x < _grid.size.x &&
-            worldCoordinates.y >= 0 &&
-            worldCoordinates.y < _grid.size.y)
+
+        if (LengthSquared(spaceOffset) > MiningReach * MiningReach)
         {
-            _grid.ToSpan2D()(worldCoordinates.x, worldCoordinates.y) = NoTile;
+            LOG_DEBUG << "out of reach -- " << spaceOffset << '\n';
+            return;
         }
-        else
+
+        // Mine the first solid tile in the line of sight from the view
+        // center, so digging can't reach through walls.
+        auto hit = CastRay(
+            _grid,
+            {_tileViewCenter, _tileViewCenter + spaceOffset});
+
+        if (hit.isHit)
         {
-            Log() << "out of bounds -- " << worldCoordinates << '\n';
+            _grid.Set(hit.tile, NoTile);
+            _light.Update(_grid, hit.tile);
         }
     }
 }
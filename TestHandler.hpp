@@ -8,13 +8,21 @@
 #include "Renderer.hpp"
 #include <vector>
 #include <random>
+#include <memory>
+#include <mutex>
 
 class TestHandler : public WindowEventHandler
 {
     std::mt19937 _mt;
-    Renderer _renderer;
-    RenderGridBuffer _buffer;
+    /// Only created when there is a window, and so a GL context. Without
+    /// one, meshing reads the region table of a CPU-side atlas.
+    std::unique_ptr<Renderer> _renderer;
+    TextureAtlas _atlas;
+    RenderGridBuffer _buffers[FrameSlotCount];
+    std::mutex _statsMutex;
+    RenderStats _renderStats;
     Grid _grid;
+    LightField _light;
     Matrix4x4F _projectionMatrix;
     Matrix4x4F _rotateMatrix;
     float _rotation = 0.0f;
@@ -29,14 +37,22 @@ class TestHandler : public WindowEventHandler
     bool _logDump = false;
 
 public:
-    TestHandler();
+    explicit TestHandler(uint32_t seed);
     virtual ~TestHandler();
 
+    inline const Grid& World() const { return _grid; }
+
+    inline const TextureAtlas& Atlas() const
+    {
+        return _renderer ? _renderer->Atlas() : _atlas;
+    }
+
     void OnOpen() override;
     void OnClose() override;
     void OnPrepareRender() override;
     void OnRender() override;
     void OnUpdate() override;
+    void OnSecond() override;
 
     void OnKeyDown(SDL_Keysym keysym) override;
     void OnKeyUp(SDL_Keysym keysym) override;
@@ -0,0 +1,300 @@
+#include "TextureAtlas.hpp"
+#include "Math.hpp"
+#include <algorithm>
+using namespace std;
+
+// Nothing in the sheet animates yet.
+const vector<TileAnimation> TileSheetAnimations;
+
+static bool IsOpaque(const Image& image)
+{
+    for (auto pixel : image.pixels)
+    {
+        if ((pixel >> 24) != 0xff) return false;
+    }
+
+    return !image.pixels.empty();
+}
+
+static bool IsEmpty(const Image& image, int x, int y, int w, int h)
+{
+    for (int i = 0; i < h; ++i)
+    {
+        for (int j = 0; j < w; ++j)
+        {
+            if (image(x + j, y + i) >> 24) return false;
+        }
+    }
+
+    return true;
+}
+
+vector<AtlasEntry> SliceSheet(const Image& sheet, int cellSize)
+{
+    vector<AtlasEntry> result;
+
+    int columns = Min(sheet.width / cellSize, 16);
+    int rows = Min(sheet.height / cellSize, 16);
+
+    for (int row = 0; row < rows; ++row)
+    {
+        for (int column = 0; column < columns; ++column)
+        {
+            int x = column * cellSize;
+            int y = row * cellSize;
+            if (IsEmpty(sheet, x, y, cellSize, cellSize)) continue;
+
+            AtlasEntry entry;
+            entry.id = uint16_t((row << 4) | column);
+            entry.image.width = cellSize;
+            entry.image.height = cellSize;
+            entry.image.pixels.resize(cellSize * cellSize);
+
+            for (int i = 0; i < cellSize; ++i)
+            {
+                for (int j = 0; j < cellSize; ++j)
+                    entry.image(j, i) = sheet(x + j, y + i);
+            }
+
+            result.push_back(move(entry));
+        }
+    }
+
+    return result;
+}
+
+/// Copies the image into the atlas at (x, y) and smears its border pixels
+/// outward across the gutter so filtering never reaches a neighbor.
+static void Blit(Image& atlas, const Image& image, int x, int y, int gutter)
+{
+    for (int i = -gutter; i < image.height + gutter; ++i)
+    {
+        int sy = Restricted(i, 0, image.height - 1);
+
+        for (int j = -gutter; j < image.width + gutter; ++j)
+        {
+            int sx = Restricted(j, 0, image.width - 1);
+            atlas(x + j, y + i) = image(sx, sy);
+        }
+    }
+}
+
+/// Alpha-weighted 2x2 box filter. Weighting keeps transparent texels from
+/// darkening the edges of opaque ones.
+static Image Downsample(const Image& source)
+{
+    Image result;
+    result.width = Max(source.width / 2, 1);
+    result.height = Max(source.height / 2, 1);
+    result.pixels.resize(result.width * result.height);
+
+    for (int y = 0; y < result.height; ++y)
+    {
+        for (int x = 0; x < result.width; ++x)
+        {
+            uint32_t sums[3] = {};
+            uint32_t alpha = 0;
+
+            for (int i = 0; i < 4; ++i)
+            {
+                int sx = Min(x * 2 + (i & 1), source.width - 1);
+                int sy = Min(y * 2 + (i >> 1), source.height - 1);
+                auto pixel = source(sx, sy);
+                uint32_t a = pixel >> 24;
+
+                for (int c = 0; c < 3; ++c)
+                    sums[c] += ((pixel >> (c * 8)) & 0xff) * a;
+
+                alpha += a;
+            }
+
+            uint32_t pixel = ((alpha + 2) / 4) << 24;
+
+            if (alpha)
+            {
+                for (int c = 0; c < 3; ++c)
+                    pixel |= ((sums[c] + alpha / 2) / alpha) << (c * 8);
+            }
+
+            result(x, y) = pixel;
+        }
+    }
+
+    return result;
+}
+
+TextureAtlas PackAtlas(
+    const vector<AtlasEntry>& entries,
+    int gutter,
+    const vector<TileAnimation>& animations)
+{
+    TextureAtlas result;
+
+    // Slots start on multiples of twice the gutter, so every mip level that
+    // still has gutter pixels left keeps cells on whole texel boundaries.
+    int alignment = Max(gutter * 2, 1);
+    auto align = [alignment](int n)
+    {
+        return (n + alignment - 1) / alignment * alignment;
+    };
+
+    uint16_t highestId = 0;
+    for (const auto& entry : entries)
+        highestId = Max(highestId, entry.id);
+
+    vector<int> entryById(entries.empty() ? 0 : highestId + 1, -1);
+    for (size_t i = 0; i < entries.size(); ++i)
+        entryById[entries[i].id] = int(i);
+
+    // Each group is packed as one run of equal slots: a lone entry, or all
+    // frames of an animation.
+    struct Group
+    {
+        vector<int> members;
+        int slotWidth = 0;
+        int slotHeight = 0;
+        int animation = 0;
+    };
+
+    vector<Group> groups;
+    vector<bool> grouped(entries.size(), false);
+
+    for (const auto& animation : animations)
+    {
+        if (result.animations.size() + 1 >= size_t(MaxAtlasAnimations)) break;
+
+        Group group;
+        for (int k = 0; k < animation.frameCount; ++k)
+        {
+            size_t id = animation.id + k;
+            if (id >= entryById.size() || entryById[id] < 0 ||
+                grouped[entryById[id]])
+            {
+                group.members.clear();
+                break;
+            }
+
+            group.members.push_back(entryById[id]);
+        }
+
+        if (group.members.empty()) continue;
+
+        for (int index : group.members) grouped[index] = true;
+        result.animations.push_back(
+            {animation.frameCount, animation.frameMilliseconds, 0.0f});
+        group.animation = int(result.animations.size());
+        groups.push_back(move(group));
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (grouped[i]) continue;
+        Group group;
+        group.members.push_back(int(i));
+        groups.push_back(move(group));
+    }
+
+    for (auto& group : groups)
+    {
+        for (int index : group.members)
+        {
+            const auto& image = entries[index].image;
+            group.slotWidth = Max(
+                group.slotWidth,
+                align(image.width + gutter * 2));
+            group.slotHeight = Max(
+                group.slotHeight,
+                align(image.height + gutter * 2));
+        }
+    }
+
+    sort(groups.begin(), groups.end(), [](const Group& a, const Group& b)
+    {
+        return a.slotHeight > b.slotHeight;
+    });
+
+    // Shelf packing: rows of slots, each as tall as its tallest entry.
+    // Grow the square until everything fits.
+    vector<pair<int, int>> positions(entries.size());
+    int size = 64;
+
+    for (bool fits = false; !fits; )
+    {
+        fits = true;
+        int x = 0;
+        int y = 0;
+        int shelfHeight = 0;
+
+        for (const auto& group : groups)
+        {
+            int w = group.slotWidth * int(group.members.size());
+            int h = group.slotHeight;
+
+            if (x + w > size)
+            {
+                x = 0;
+                y += shelfHeight;
+                shelfHeight = 0;
+            }
+
+            if (w > size || y + h > size)
+            {
+                fits = false;
+                size *= 2;
+                break;
+            }
+
+            for (size_t k = 0; k < group.members.size(); ++k)
+            {
+                positions[group.members[k]] = {
+                    x + int(k) * group.slotWidth + gutter,
+                    y + gutter};
+            }
+
+            x += w;
+            shelfHeight = Max(shelfHeight, h);
+        }
+    }
+
+    result.animation.resize(entryById.size(), 0);
+    for (const auto& group : groups)
+    {
+        if (!group.animation) continue;
+        result.animations[group.animation - 1].step =
+            float(group.slotWidth) / float(size);
+        result.animation[entries[group.members[0]].id] =
+            uint8_t(group.animation);
+    }
+
+    Image atlas;
+    atlas.width = size;
+    atlas.height = size;
+    atlas.pixels.resize(size * size, 0);
+
+    result.regions.resize(entries.empty() ? 0 : highestId + 1, AtlasRegion{});
+    result.opaque.resize(result.regions.size(), 0);
+
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        const auto& image = entries[i].image;
+        int x = positions[i].first;
+        int y = positions[i].second;
+        Blit(atlas, image, x, y, gutter);
+
+        auto scale = 1.0f / float(size);
+        result.regions[entries[i].id] = {
+            float(x) * scale,
+            float(y) * scale,
+            float(x + image.width) * scale,
+            float(y + image.height) * scale};
+        result.opaque[entries[i].id] = IsOpaque(image);
+    }
+
+    for (int n = gutter; n > 1; n /= 2) ++result.maxCleanLevel;
+
+    result.mipLevels.push_back(move(atlas));
+    while (result.mipLevels.back().width > 1)
+        result.mipLevels.push_back(Downsample(result.mipLevels.back()));
+
+    return result;
+}
@@ -0,0 +1,102 @@
+#ifndef TextureAtlas_hpp
+#define TextureAtlas_hpp
+
+#include "Image.hpp"
+#include <vector>
+#include <cstdint>
+
+/// Layout of images/sheet.png and the padding the tile atlas is built with.
+constexpr int TileSheetCellSize = 64;
+constexpr int TileAtlasGutter = 8;
+
+/// Texture coordinates of one packed image. (s0, t0) is the top left.
+struct AtlasRegion
+{
+    float s0;
+    float t0;
+    float s1;
+    float t1;
+};
+
+/// Frames of an animated tile are consecutive sheet cells, starting at the
+/// ID the grid stores.
+struct TileAnimation
+{
+    uint16_t id;
+    uint16_t frameCount;
+    uint16_t frameMilliseconds;
+};
+
+/// Animations used by images/sheet.png.
+extern const std::vector<TileAnimation> TileSheetAnimations;
+
+/// Packed form of a TileAnimation. Frame k sits k * step to the right of
+/// the first frame's region, so the vertex shader can pick it.
+struct AtlasAnimation
+{
+    uint16_t frameCount;
+    uint16_t frameMilliseconds;
+    float step;
+};
+
+/// Size of the shader's animation table. Slot 0 stands for "not animated".
+constexpr int MaxAtlasAnimations = 16;
+
+struct AtlasEntry
+{
+    uint16_t id;
+    Image image;
+};
+
+struct TextureAtlas
+{
+    /// Level 0 is full size; each following level halves it down to 1x1.
+    /// The renderer may drop these once they are uploaded.
+    std::vector<Image> mipLevels;
+
+    /// Highest mip level at which the gutters still keep neighbors apart.
+    int maxCleanLevel = 0;
+
+    /// Indexed by ID. IDs that were never packed map to an empty region.
+    std::vector<AtlasRegion> regions;
+
+    /// Nonzero for IDs whose image has no transparent pixels, so nothing
+    /// behind them can show through.
+    std::vector<uint8_t> opaque;
+
+    /// Indexed by ID: zero for still tiles, otherwise one past the index
+    /// into animations.
+    std::vector<uint8_t> animation;
+    std::vector<AtlasAnimation> animations;
+
+    inline AtlasRegion Region(uint16_t id) const
+    {
+        return id < regions.size() ? regions[id] : AtlasRegion{};
+    }
+
+    inline bool IsOpaque(uint16_t id) const
+    {
+        return id < opaque.size() && opaque[id];
+    }
+
+    inline uint8_t Animation(uint16_t id) const
+    {
+        return id < animation.size() ? animation[id] : 0;
+    }
+};
+
+/// Cuts a sheet into square cells. A cell's ID is its row in the upper
+/// nibble and its column in the lower, matching the Grid tile encoding.
+/// Fully transparent cells are left out.
+std::vector<AtlasEntry> SliceSheet(const Image& sheet, int cellSize);
+
+/// Packs the entries into one power-of-two square, surrounding each with
+/// gutter pixels copied from its edges, and builds the full mip chain.
+/// The frames of each animation are packed side by side on one shelf;
+/// animations with frames missing from the entries stay still.
+TextureAtlas PackAtlas(
+    const std::vector<AtlasEntry>& entries,
+    int gutter,
+    const std::vector<TileAnimation>& animations = {});
+
+#endif
@@ -0,0 +1,46 @@
+#include "VertexStream.hpp"
+
+VertexStream::VertexStream(GLsizeiptr capacity)
+    : _capacity(capacity)
+{
+    glGenBuffers(1, &_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+    glBufferData(GL_ARRAY_BUFFER, _capacity, nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+VertexStream::~VertexStream()
+{
+    glDeleteBuffers(1, &_buffer);
+}
+
+GLintptr VertexStream::Write(
+    RenderState& state,
+    const void* data,
+    GLsizeiptr size)
+{
+    state.BindArrayBuffer(_buffer);
+
+    if (size > _capacity)
+    {
+        // Grow to fit. Doubling keeps this from happening every frame.
+        while (_capacity < size) _capacity *= 2;
+        _offset = _capacity;
+    }
+
+    if (_offset + size > _capacity)
+    {
+        // Orphan the old storage rather than overwrite bytes the GPU may
+        // still be reading from a previous frame.
+        glBufferData(GL_ARRAY_BUFFER, _capacity, nullptr, GL_STREAM_DRAW);
+        state.Count();
+        _offset = 0;
+    }
+
+    GLintptr offset = _offset;
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    state.Count();
+    _offset += size;
+
+    return offset;
+}
@@ -0,0 +1,32 @@
+#ifndef VertexStream_hpp
+#define VertexStream_hpp
+
+#include "RenderState.hpp"
+
+/// Ring buffer for vertex data that changes every frame. Writes append
+/// behind the previous one; when the ring is full, the storage is orphaned
+/// so the driver can hand out fresh memory instead of waiting for the GPU
+/// to finish reading the old contents.
+class VertexStream
+{
+    GLuint _buffer = 0;
+    GLsizeiptr _capacity;
+    GLsizeiptr _offset = 0;
+
+public:
+    VertexStream(GLsizeiptr capacity);
+    VertexStream(VertexStream&&) = delete;
+    VertexStream(const VertexStream&) = delete;
+    ~VertexStream();
+
+    VertexStream& operator=(VertexStream&&) = delete;
+    VertexStream& operator=(const VertexStream&) = delete;
+
+    /// Binds the ring as GL_ARRAY_BUFFER and copies the data into it.
+    /// Returns the byte offset at which the data landed.
+    GLintptr Write(RenderState& state, const void* data, GLsizeiptr size);
+
+    inline GLuint Buffer() const { return _buffer; }
+};
+
+#endif
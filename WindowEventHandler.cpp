@@ -1,8 +1,12 @@
 #include "WindowEventHandler.hpp"
 #include "Debug.hpp"
 #include "OpenGL.hpp"
+#include "Pacing.hpp"
+#include "Process.hpp"
+#include "Profile.hpp"
 #include <iostream>
 #include <cassert>
+#include <cmath>
 using namespace std;
 
 WindowEventHandler::WindowEventHandler()
@@ -14,11 +18,50 @@ WindowEventHandler::~WindowEventHandler()
 {
 }
 
+// Running totals for the metrics file; the per-second log keeps its own
+// counts.
+static auto& theUpdates = RegisterCounter("updates");
+static auto& thePrepareRenders = RegisterCounter("prepare_renders");
+static auto& theFrames = RegisterCounter("frames");
+static auto& theSleeps = RegisterCounter("sleeps");
+static auto& theUpdatesPerPass = RegisterGauge("updates_per_pass");
+
+/// How late each update starts relative to its slot on the schedule.
+static auto& theUpdateLag = RegisterHistogram("update_lag_ns");
+
+static const char* const PhaseNames[] = {
+    "events",
+    "update",
+    "prepare render",
+    "render",
+    "swap",
+    "sleep"};
+
 void WindowEventHandler::SetUpdatesPerSecond(int updatesPerSecond)
 {
     assert(updatesPerSecond > 0);
     _updatesPerSecond = updatesPerSecond;
     _frameLength = SDL_GetPerformanceFrequency() / updatesPerSecond;
+    _nanosecondsPerTick = 1e9 / double(SDL_GetPerformanceFrequency());
+}
+
+void WindowEventHandler::SetFrameRateCap(int framesPerSecond)
+{
+    assert(framesPerSecond >= 0);
+    _renderLength = framesPerSecond
+        ? SDL_GetPerformanceFrequency() / framesPerSecond
+        : 0;
+}
+
+void WindowEventHandler::RecordTo(const char* path, uint32_t seed)
+{
+    _recordPath = path;
+    _recordSeed = seed;
+}
+
+bool WindowEventHandler::WriteMetricsTo(const char* path)
+{
+    return _metrics.Open(path);
 }
 
 void WindowEventHandler::Run(SDL_Window* window)
@@ -31,43 +74,127 @@ void WindowEventHandler::Run(SDL_Window* window)
     SDL_GetWindowSize(window, &w, &h);
     OnResize(w, h);
 
+    _tickCount = 0;
+    if (!_recordPath.empty())
+        _recorder.Open(_recordPath.c_str(), _recordSeed, w, h);
+
+    SDL_GLContext context = nullptr;
+    bool isRenderThreaded = _useRenderThread;
+    _prepareSlot = 0;
+    _readySlot = 0;
+    _renderSlot = 0;
+    _appliedViewport = {};
+
+    for (auto& phase : _phases) phase.Reset();
+
+    if (isRenderThreaded)
+    {
+        context = SDL_GL_GetCurrentContext();
+        SDL_GL_MakeCurrent(window, nullptr);
+
+        _readySlot = 1;
+        _renderSlot = 2;
+        _hasReadyFrame = false;
+        _redrawRequested = false;
+        _stopRendering = false;
+        _renderThread = thread(&WindowEventHandler::RenderLoop, this, context);
+    }
+
     auto secondLength = SDL_GetPerformanceFrequency();
     auto lastUpdate = SDL_GetPerformanceCounter();
     auto lastSecond = lastUpdate;
+    auto lastRender = lastUpdate;
+    auto lastCpuSeconds = ProcessCpuSeconds();
+    Uint64 previousUpdateTime = 0;
     int peakUpdateCount = 0;
     int prepareRenderCount = 0;
     int renderCount = 0;
     int sleepCount = 0;
 
+    // Jitter is how far the spacing between consecutive OnUpdate calls
+    // strays from _frameLength.
+    int intervalCount = 0;
+    double intervalSum = 0.0;
+    double intervalSquareSum = 0.0;
+    Uint64 worstJitter = 0;
+
     FlushLog();
+    PROFILE_THREAD("main");
     _running = true;
 
     while (_running)
     {
+        PROFILE_ZONE("MainLoop");
         bool doSleep = true;
         _needPrepareRender = false;
         _needRender = false;
 
-        SDL_Event event;
-        while (SDL_PollEvent(&event)) OnEvent(event);
+        // Sampled once per pass, so a disabled pass costs one branch per
+        // phase and no counter reads.
+        bool isTiming = _logStats;
+        auto phaseStart = isTiming ? SDL_GetPerformanceCounter() : 0;
+
+        {
+            PROFILE_ZONE("Events");
+            SDL_Event event;
+            while (SDL_PollEvent(&event))
+            {
+                _recorder.Add(_tickCount, event);
+                OnEvent(event);
+            }
+        }
 
         auto now = SDL_GetPerformanceCounter();
+        if (isTiming) RecordPhase(EventPhase, phaseStart, now);
 
         assert(now >= lastSecond);
         if ((now - lastSecond) >= secondLength)
         {
             if (_logStats)
             {
-                Log() << prepareRenderCount << " calls to OnPrepareRender\n";
-                Log() << renderCount << " calls to OnRender\n";
-                Log() << sleepCount << " sleeps ("
+                LOG_INFO << prepareRenderCount << " calls to OnPrepareRender\n";
+                LOG_INFO << renderCount << (isRenderThreaded
+                    ? " frames published to the render thread\n"
+                    : " calls to OnRender\n");
+                LOG_INFO << sleepCount << " sleeps ("
                     << (sleepCount / _updatesPerSecond)
                     << " sleeps per frame)\n";
+
+                auto cpuSeconds = ProcessCpuSeconds();
+                LOG_INFO << "CPU use "
+                    << ((cpuSeconds - lastCpuSeconds) * 100.0 *
+                        double(secondLength) / double(now - lastSecond))
+                    << "% with "
+                    << (_precisePacing ? "precise" : "SDL_Delay")
+                    << " pacing\n";
+
+                if (intervalCount > 0)
+                {
+                    auto toMicroseconds = 1000000.0 / double(secondLength);
+                    auto mean = intervalSum / intervalCount;
+                    auto variance =
+                        intervalSquareSum / intervalCount - mean * mean;
+
+                    LOG_INFO << "update interval: mean "
+                        << (mean * toMicroseconds) << " us, stddev "
+                        << (sqrt(variance > 0.0 ? variance : 0.0) *
+                            toMicroseconds)
+                        << " us, worst jitter "
+                        << (double(worstJitter) * toMicroseconds)
+                        << " us\n";
+                }
             }
 
+            ReportPhases(_logStats);
+
             prepareRenderCount = 0;
             renderCount = 0;
             sleepCount = 0;
+            intervalCount = 0;
+            intervalSum = 0.0;
+            intervalSquareSum = 0.0;
+            worstJitter = 0;
+            lastCpuSeconds = ProcessCpuSeconds();
             OnSecond();
             lastSecond = now;
             FlushLog();
@@ -78,50 +205,324 @@ void WindowEventHandler::Run(SDL_Window* window)
         assert(now >= lastUpdate);
         while ((now - lastUpdate) >= _frameLength)
         {
+            PROFILE_ZONE("Update");
+            auto updateTime = SDL_GetPerformanceCounter();
+
+            if (previousUpdateTime)
+            {
+                auto interval = updateTime - previousUpdateTime;
+                auto jitter = interval > _frameLength
+                    ? interval - _frameLength
+                    : _frameLength - interval;
+
+                ++intervalCount;
+                intervalSum += double(interval);
+                intervalSquareSum += double(interval) * double(interval);
+                if (jitter > worstJitter) worstJitter = jitter;
+            }
+
+            previousUpdateTime = updateTime;
             OnUpdate();
+            ++_tickCount;
+            theUpdates.Add();
+
+            auto lag = updateTime - (lastUpdate + _frameLength);
+            theUpdateLag.Record(Uint64(double(lag) * _nanosecondsPerTick));
+
+            if (isTiming)
+            {
+                RecordPhase(
+                    UpdatePhase,
+                    updateTime,
+                    SDL_GetPerformanceCounter());
+            }
+
             lastUpdate += _frameLength;
             ++updateCount;
         }
 
         if (updateCount > 0)
         {
-            if (updateCount > peakUpdateCount)
+            _jobs.Wait(_frameTasks);
+            theUpdatesPerPass.Set(updateCount);
+        }
+
+        PROFILE_COUNTER("updates per pass", updateCount);
+
+        if (updateCount > peakUpdateCount)
+        {
+            LOG_DEBUG << "new peak update count: " << peakUpdateCount << " -> "
+                << updateCount << '\n';
+            peakUpdateCount = updateCount;
+        }
+
+        bool isRenderDue = updateCount > 0;
+
+        if (_renderLength)
+        {
+            isRenderDue = (now - lastRender) >= _renderLength;
+
+            if (isRenderDue)
             {
-                Log() << "new peak update count: " << peakUpdateCount << " -> "
-                    << updateCount << '\n';
-                peakUpdateCount = updateCount;
+                // Drop frames that are already late instead of bursting.
+                lastRender += _renderLength;
+                if ((now - lastRender) >= _renderLength) lastRender = now;
             }
+        }
 
+        if (isRenderDue)
+        {
             _needPrepareRender = true;
             _needRender = true;
         }
 
         if (_needPrepareRender)
         {
+            PROFILE_ZONE("PrepareRender");
             ++prepareRenderCount;
+            thePrepareRenders.Add();
             doSleep = false;
+            phaseStart = isTiming ? SDL_GetPerformanceCounter() : 0;
             OnPrepareRender();
+            _jobs.Wait(_frameTasks);
+
+            if (isTiming)
+            {
+                RecordPhase(
+                    PrepareRenderPhase,
+                    phaseStart,
+                    SDL_GetPerformanceCounter());
+            }
+
+            _slotViewports[_prepareSlot] = _viewport;
+            _slotTimesPhases[_prepareSlot] = isTiming;
         }
 
         if (_needRender)
         {
             ++renderCount;
+            theFrames.Add();
             doSleep = false;
-            OnRender();
-            SDL_GL_SwapWindow(window);
+
+            if (!isRenderThreaded)
+                RenderFrame(_renderSlot);
+            else if (_needPrepareRender)
+                PublishFrame();
+            else
+                RequestRedraw();
         }
 
         if (doSleep)
         {
+            PROFILE_ZONE("Sleep");
             ++sleepCount;
-            SDL_Delay(1);
+            theSleeps.Add();
+            phaseStart = isTiming ? SDL_GetPerformanceCounter() : 0;
+
+            if (_precisePacing)
+            {
+                auto deadline = lastUpdate + _frameLength;
+                if (_renderLength && lastRender + _renderLength < deadline)
+                    deadline = lastRender + _renderLength;
+
+                WaitUntil(deadline);
+            }
+            else
+            {
+                SDL_Delay(1);
+            }
+
+            if (isTiming)
+                RecordPhase(SleepPhase, phaseStart, SDL_GetPerformanceCounter());
+        }
+    }
+
+    if (isRenderThreaded)
+    {
+        {
+            lock_guard<mutex> lock(_frameMutex);
+            _stopRendering = true;
         }
+
+        _frameCondition.notify_one();
+        _renderThread.join();
+        SDL_GL_MakeCurrent(window, context);
     }
 
+    _recorder.Close(_tickCount);
     OnClose();
     _window = nullptr;
 }
 
+Uint64 WindowEventHandler::Replay(const InputLog& log, bool isPreparingRender)
+{
+    OnOpen();
+    OnResize(log.width, log.height);
+    auto start = SDL_GetPerformanceCounter();
+
+    _tickCount = 0;
+    size_t next = 0;
+
+    while (true)
+    {
+        while (next < log.events.size() &&
+            log.events[next].tick <= _tickCount)
+        {
+            OnEvent(log.events[next++].event);
+        }
+
+        if (_tickCount >= log.tickCount) break;
+
+        OnUpdate();
+        ++_tickCount;
+        theUpdates.Add();
+        _jobs.Wait(_frameTasks);
+
+        if (isPreparingRender)
+        {
+            thePrepareRenders.Add();
+            OnPrepareRender();
+            _jobs.Wait(_frameTasks);
+        }
+
+        if (!(_tickCount % _updatesPerSecond)) OnSecond();
+    }
+
+    auto elapsed = SDL_GetPerformanceCounter() - start;
+    OnClose();
+    return elapsed;
+}
+
+void WindowEventHandler::PublishFrame()
+{
+    {
+        lock_guard<mutex> lock(_frameMutex);
+        swap(_prepareSlot, _readySlot);
+        _hasReadyFrame = true;
+    }
+
+    _frameCondition.notify_one();
+}
+
+void WindowEventHandler::RequestRedraw()
+{
+    {
+        lock_guard<mutex> lock(_frameMutex);
+        _redrawRequested = true;
+    }
+
+    _frameCondition.notify_one();
+}
+
+void WindowEventHandler::RenderLoop(SDL_GLContext context)
+{
+    SDL_GL_MakeCurrent(_window, context);
+    PROFILE_THREAD("render");
+    unique_lock<mutex> lock(_frameMutex);
+
+    while (true)
+    {
+        _frameCondition.wait(lock, [this]
+        {
+            return _hasReadyFrame || _redrawRequested || _stopRendering;
+        });
+
+        if (_stopRendering) break;
+
+        if (_hasReadyFrame)
+        {
+            swap(_readySlot, _renderSlot);
+            _hasReadyFrame = false;
+        }
+
+        _redrawRequested = false;
+        int slot = _renderSlot;
+
+        lock.unlock();
+        RenderFrame(slot);
+        lock.lock();
+    }
+
+    lock.unlock();
+    SDL_GL_MakeCurrent(_window, nullptr);
+}
+
+void WindowEventHandler::RenderFrame(int slot)
+{
+    PROFILE_ZONE("RenderFrame");
+    auto viewport = _slotViewports[slot];
+
+    if (viewport.width != _appliedViewport.width ||
+        viewport.height != _appliedViewport.height)
+    {
+        glViewport(0, 0, viewport.width, viewport.height);
+        _appliedViewport = viewport;
+    }
+
+    if (!_slotTimesPhases[slot])
+    {
+        OnRender();
+        PROFILE_ZONE("Swap");
+        SDL_GL_SwapWindow(_window);
+        return;
+    }
+
+    auto renderStart = SDL_GetPerformanceCounter();
+    OnRender();
+    auto swapStart = SDL_GetPerformanceCounter();
+
+    {
+        PROFILE_ZONE("Swap");
+        SDL_GL_SwapWindow(_window);
+    }
+
+    auto swapEnd = SDL_GetPerformanceCounter();
+
+    RecordPhase(RenderPhase, renderStart, swapStart);
+    RecordPhase(SwapPhase, swapStart, swapEnd);
+}
+
+void WindowEventHandler::RecordPhase(Phase phase, Uint64 start, Uint64 end)
+{
+    auto nanoseconds = Uint64(double(end - start) * _nanosecondsPerTick);
+
+    if (phase == RenderPhase || phase == SwapPhase)
+    {
+        lock_guard<mutex> lock(_phaseMutex);
+        _phases[phase].Record(nanoseconds);
+    }
+    else
+    {
+        _phases[phase].Record(nanoseconds);
+    }
+}
+
+/// Logs each phase's percentiles if asked, then starts the next second
+/// afresh.
+void WindowEventHandler::ReportPhases(bool isLogging)
+{
+    lock_guard<mutex> lock(_phaseMutex);
+
+    for (int i = 0; i < PhaseCount; ++i)
+    {
+        auto& phase = _phases[i];
+        if (!isLogging || !phase.Count())
+        {
+            phase.Reset();
+            continue;
+        }
+
+        LOG_INFO << PhaseNames[i] << " (us): p50 "
+            << (double(phase.Percentile(0.50)) / 1000.0) << " p95 "
+            << (double(phase.Percentile(0.95)) / 1000.0) << " p99 "
+            << (double(phase.Percentile(0.99)) / 1000.0) << " max "
+            << (double(phase.Max()) / 1000.0) << " over "
+            << phase.Count() << " samples\n";
+
+        phase.Reset();
+    }
+}
+
 void WindowEventHandler::OnOpen()
 {
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -150,6 +551,7 @@ void WindowEventHandler::OnUpdate()
 
 void WindowEventHandler::OnSecond()
 {
+    _metrics.Write(_tickCount);
 }
 
 void WindowEventHandler::OnEvent(SDL_Event event)
@@ -330,9 +732,9 @@ void WindowEventHandler::OnRestore()
 
 void WindowEventHandler::OnResize(Sint32 width, Sint32 height)
 {
-    (void)width;
-    (void)height;
-    glViewport(0, 0, width, height);
+    // Applied with the next rendered frame, on whichever thread owns the
+    // GL context.
+    _viewport = {width, height};
 }
 
 void WindowEventHandler::OnExpose()
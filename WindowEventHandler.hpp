@@ -1,22 +1,112 @@
 #ifndef WindowEventHandler_hpp
 #define WindowEventHandler_hpp
 
+#include "Histogram.hpp"
+#include "InputLog.hpp"
+#include "Jobs.hpp"
+#include "Metrics.hpp"
 #include <SDL.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
 
 class WindowEventHandler
 {
+public:
+    /// Frame data handed from OnPrepareRender to OnRender lives in this
+    /// many slots. See PrepareSlot and RenderSlot.
+    static constexpr int FrameSlotCount = 3;
+
+private:
+    struct Viewport
+    {
+        Sint32 width;
+        Sint32 height;
+    };
+
+    /// Loop phases timed while _logStats is on.
+    enum Phase
+    {
+        EventPhase,
+        UpdatePhase,
+        PrepareRenderPhase,
+        RenderPhase,
+        SwapPhase,
+        SleepPhase,
+        PhaseCount
+    };
+
     Uint64 _frameLength;
+    Uint64 _renderLength = 0; // Zero renders after every batch of updates.
     SDL_Window* _window = nullptr;
     int _updatesPerSecond;
     bool _running;
     bool _needPrepareRender;
     bool _needRender;
+    bool _useRenderThread = false;
+    bool _precisePacing = true;
+    Viewport _viewport = {};
+    Viewport _slotViewports[FrameSlotCount] = {};
+    Viewport _appliedViewport = {};
+    bool _slotTimesPhases[FrameSlotCount] = {};
+
+    /// The render and swap phases may be recorded on the render thread,
+    /// so every histogram is read and reset under _phaseMutex.
+    Histogram _phases[PhaseCount];
+    std::mutex _phaseMutex;
+    double _nanosecondsPerTick;
+
+    JobSystem _jobs;
+    TaskGroup _frameTasks;
+
+    /// Counts OnUpdate calls; input logs stamp events with it.
+    uint64_t _tickCount = 0;
+    InputRecorder _recorder;
+    std::string _recordPath;
+    uint32_t _recordSeed = 0;
+
+    MetricsWriter _metrics;
+
+    /// With the render thread, slots rotate through three roles: the main
+    /// thread fills the prepare slot, publishing swaps it with the ready
+    /// slot, and the render thread swaps the ready slot for its render
+    /// slot. Neither side ever waits for the other to finish a frame.
+    std::thread _renderThread;
+    std::mutex _frameMutex;
+    std::condition_variable _frameCondition;
+    int _prepareSlot = 0;
+    int _readySlot = 0;
+    int _renderSlot = 0;
+    bool _hasReadyFrame = false;
+    bool _redrawRequested = false;
+    bool _stopRendering = false;
+
+    void PublishFrame();
+    void RequestRedraw();
+    void RenderLoop(SDL_GLContext context);
+    void RenderFrame(int slot);
+    void RecordPhase(Phase phase, Uint64 start, Uint64 end);
+    void ReportPhases(bool isLogging);
 
 protected:
     void SetUpdatesPerSecond(int updatesPerSecond);
     inline SDL_Window* Window() { return _window; }
+
+    /// OnUpdate and OnPrepareRender may fan work out into FrameTasks. Run
+    /// joins the group after each batch of updates and again after
+    /// OnPrepareRender, so it is all done before the frame is presented.
+    inline JobSystem& Jobs() { return _jobs; }
+    inline TaskGroup& FrameTasks() { return _frameTasks; }
     bool _logStats = false;
 
+    /// OnPrepareRender fills the prepare slot and OnRender draws the
+    /// render slot. Without the render thread both are slot zero. With it,
+    /// they always differ, and a published slot is never written again
+    /// until the render thread has let go of it.
+    inline int PrepareSlot() const { return _prepareSlot; }
+    inline int RenderSlot() const { return _renderSlot; }
+
 public:
     WindowEventHandler();
     WindowEventHandler(const WindowEventHandler&) = delete;
@@ -27,14 +117,44 @@ public:
     WindowEventHandler& operator=(const WindowEventHandler&) = delete;
     WindowEventHandler& operator=(WindowEventHandler&&) = delete;
 
+    /// Moves OnRender and the buffer swap onto their own thread, which
+    /// takes over the GL context for the duration of Run. OnRender must
+    /// then only read frame data from its render slot.
+    inline void SetRenderThreaded(bool enabled) { _useRenderThread = enabled; }
+
+    /// Sleeps until the next update or frame is due rather than polling
+    /// every millisecond with SDL_Delay(1).
+    inline void SetPrecisePacing(bool enabled) { _precisePacing = enabled; }
+
+    /// Renders at most framesPerSecond frames, on a schedule of their own
+    /// independent of the update rate. Zero removes the cap, rendering
+    /// once after every batch of updates.
+    void SetFrameRateCap(int framesPerSecond);
+
+    /// Makes the next Run record every event it handles to path. The seed
+    /// is stored so a replay can rebuild the same world.
+    void RecordTo(const char* path, uint32_t seed);
+
+    /// Appends a snapshot of every registered metric to path from each
+    /// OnSecond, stamped with the tick count.
+    bool WriteMetricsTo(const char* path);
+
     void Run(SDL_Window* window);
+
+    /// Feeds a log through OnEvent and OnUpdate as fast as they will go,
+    /// with no window, GL or sleeping. Time is virtual: each update is one
+    /// tick, and OnSecond follows every updates-per-second ticks. With
+    /// isPreparingRender, OnPrepareRender runs after every update too.
+    /// Returns the performance counter ticks spent stepping, leaving out
+    /// OnOpen and OnClose.
+    Uint64 Replay(const InputLog& log, bool isPreparingRender = false);
     void OnEvent(SDL_Event event);
 
     /// high level operation
     virtual void OnOpen();
     virtual void OnClose();
     virtual void OnPrepareRender();
-    virtual void OnRender();
+    virtual void OnRender(); // Called on the render thread, if enabled.
     virtual void OnLoop();
     virtual void OnUpdate();
     virtual void OnSecond();
@@ -1 +1 @@
-g++ -std=c++11 -O2 -I/usr/include/SDL2 *.cpp -lSDL2main -lSDL2 -lSDL2_image -lGL -lGLEW
+g++ -std=c++11 -O2 -I/usr/include/SDL2 *.cpp -lSDL2main -lSDL2 -lSDL2_image -lGL -lGLEW -lEGL
@@ -1 +1 @@
-g++ -std=c++11 -DKerrariaES2 `sdl2-config --cflags` *.cpp `sdl2-config --libs` -lSDL2_image -L/opt/vc/lib -lbcm_host -lGLESv2
+g++ -std=c++11 -DKerrariaES2 `sdl2-config --cflags` *.cpp `sdl2-config --libs` -lSDL2_image -L/opt/vc/lib -lbcm_host -lEGL -lGLESv2
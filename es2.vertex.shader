@@ -1,14 +1,20 @@
 uniform highp mat4 theMatrix;
+uniform highp float theTime;
+uniform highp vec3 theAnimations[16]; // Frame count, frames per second, s step.
 attribute highp vec3 position;
 attribute lowp vec3 color;
 attribute lowp vec2 textureCoordinates;
+attribute mediump float animation;
 varying lowp vec3 _color;
 varying lowp vec2 _textureCoordinates;
 
 void main()
 {
+    highp vec3 a = theAnimations[int(animation)];
+    highp float frame = floor(mod(theTime * a.y, a.x));
+
     _color = color;
-    _textureCoordinates = textureCoordinates;
+    _textureCoordinates = textureCoordinates + vec2(frame * a.z, 0.0);
     gl_Position = theMatrix * vec4(position, 1.0);
 }
 
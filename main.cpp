@@ -1,5 +1,11 @@
 #include "TestHandler.hpp"
+#include "Headless.hpp"
+#include "Benchmark.hpp"
 #include "Debug.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <memory>
 #include <iostream>
 #include <fstream>
@@ -18,7 +24,7 @@ static void MyCallback(
     const GLchar* msg,
     const void* data)
 {
-    if (msg && *msg) Log() << "[OpenGL] " << msg << '\n';
+    if (msg && *msg) LOG_WARNING << "[OpenGL] " << msg << '\n';
 }
 
 static const char* GetString(GLenum name)
@@ -74,7 +80,13 @@ static void SetIcon(SDL_Window* window)
     SDL_FreeSurface(surface);
 }
 
-static void RunWindow()
+static void RunWindow(
+    bool isRenderThreaded,
+    bool isPrecisePacing,
+    int frameRateCap,
+    uint32_t seed,
+    const char* recordPath,
+    const char* metricsPath)
 {
     ofstream fout("debug.txt", ofstream::binary);
     AddLogStream(cout);
@@ -94,7 +106,7 @@ static void RunWindow()
 #else
     SDL_DisplayMode mode;
     SDL_GetDesktopDisplayMode(0, &mode);
-    Log() << "mode: " << mode.w << "x" << mode.h << '\n';
+    LOG_INFO << "mode: " << mode.w << "x" << mode.h << '\n';
 #endif
 
     auto window = SDL_CreateWindow(
@@ -123,13 +135,13 @@ static void RunWindow()
     glewInit();
 #endif
 
-    Log() << "SDL_GL_SetSwapInterval ";
+    LOG_INFO << "SDL_GL_SetSwapInterval ";
     if (SDL_GL_SetSwapInterval(1))
-        Log() << "failed.";
+        LOG_INFO << "failed.";
     else
-        Log() << "succeeded.";
+        LOG_INFO << "succeeded.";
 
-    Log()
+    LOG_INFO
         << "\nOpenGL Vendor: " << GetString(GL_VENDOR)
         << "\nOpenGL Renderer: " << GetString(GL_RENDERER)
         << "\nOpenGL Version: " << GetString(GL_VERSION)
@@ -138,22 +150,34 @@ static void RunWindow()
         << '\n';
 
 #ifndef KerrariaES2
-    Log() << "OpenGL debug context flag ";
+    LOG_INFO << "OpenGL debug context flag ";
     GLint v;
     glGetIntegerv(GL_CONTEXT_FLAGS, &v);
     if (v & GL_CONTEXT_FLAG_DEBUG_BIT)
     {
-        Log() << "enabled\n";
+        LOG_INFO << "enabled\n";
         glDebugMessageCallback((GLDEBUGPROC)MyCallback, nullptr);
     }
     else
     {
-        Log() << "disabled\n";
+        LOG_INFO << "disabled\n";
     }
 #endif
 
-    auto th = make_unique<TestHandler>();
+    auto th = make_unique<TestHandler>(seed);
+    if (recordPath) th->RecordTo(recordPath, seed);
+    if (metricsPath) th->WriteMetricsTo(metricsPath);
+    th->SetRenderThreaded(isRenderThreaded);
+    th->SetPrecisePacing(isPrecisePacing);
+    th->SetFrameRateCap(frameRateCap);
     th->Run(window);
+
+    if (recordPath)
+    {
+        Log() << "Recorded to " << recordPath << ", grid checksum "
+            << hex << Checksum(th->World()) << dec << '\n';
+    }
+
     th.reset(nullptr);
 
     SDL_GL_DeleteContext(context);
@@ -165,8 +189,198 @@ static void RunWindow()
     RemoveAllLogStreams();
 }
 
+static bool ParseLogLevel(const char* name, LogLevel& level)
+{
+    const char* names[] = {"debug", "info", "warning", "error"};
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (!strcmp(name, names[i]))
+        {
+            level = LogLevel(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// Sets up logging and SDL without a window, runs f, and returns its
+/// exit code.
+template<typename F> static int RunWithoutWindow(F&& f)
+{
+    ofstream fout("debug.txt", ofstream::binary);
+    AddLogStream(cout);
+    if (fout) AddLogStream(fout);
+
+    SDL_Init(SDL_INIT_TIMER);
+    IMG_Init(IMG_INIT_PNG);
+
+    int result = f();
+
+    IMG_Quit();
+    SDL_Quit();
+
+    FlushLog();
+    RemoveAllLogStreams();
+    return result;
+}
+
 int main(int argc, char** argv)
 {
-    RunWindow();
+    bool isHeadless = false;
+    bool isRenderThreaded = false;
+    bool isPrecisePacing = true;
+    int frameRateCap = 0;
+    const char* benchmark = nullptr;
+    const char* recordPath = nullptr;
+    const char* metricsPath = nullptr;
+    const char* replayPath = nullptr;
+    bool hasSeed = false;
+    uint64_t simulationTicks = 0;
+    bool isPreparingRender = false;
+    HeadlessOptions options;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        auto arg = argv[i];
+        auto value = i + 1 < argc ? argv[i + 1] : "";
+
+        if (!strcmp(arg, "--headless"))
+        {
+            isHeadless = true;
+        }
+        else if (!strcmp(arg, "--benchmark"))
+        {
+            benchmark = value;
+            ++i;
+        }
+        else if (!strcmp(arg, "--render-thread"))
+        {
+            isRenderThreaded = true;
+        }
+        else if (!strcmp(arg, "--pacing"))
+        {
+            isPrecisePacing = strcmp(value, "delay") != 0;
+            ++i;
+        }
+        else if (!strcmp(arg, "--fps-cap"))
+        {
+            frameRateCap = Max(atoi(value), 0);
+            ++i;
+        }
+        else if (!strcmp(arg, "--record"))
+        {
+            recordPath = value;
+            ++i;
+        }
+        else if (!strcmp(arg, "--metrics"))
+        {
+            metricsPath = value;
+            ++i;
+        }
+        else if (!strcmp(arg, "--replay"))
+        {
+            replayPath = value;
+            ++i;
+        }
+        else if (!strcmp(arg, "--simulate"))
+        {
+            simulationTicks = strtoull(value, nullptr, 10);
+            ++i;
+        }
+        else if (!strcmp(arg, "--prepare-render"))
+        {
+            isPreparingRender = true;
+        }
+        else if (!strcmp(arg, "--frames"))
+        {
+            options.frameCount = atoi(value);
+            ++i;
+        }
+        else if (!strcmp(arg, "--seed"))
+        {
+            options.seed = uint32_t(strtoul(value, nullptr, 10));
+            hasSeed = true;
+            ++i;
+        }
+        else if (!strcmp(arg, "--size"))
+        {
+            // WIDTHxHEIGHT and nothing after it.
+            Point<int> size;
+            char extra;
+            if (sscanf(value, "%dx%d%c", &size.x, &size.y, &extra) != 2 ||
+                size.x < 1 ||
+                size.y < 1)
+            {
+                cout << "unknown size " << value << endl;
+                return 1;
+            }
+
+            options.displaySize = size;
+            ++i;
+        }
+        else if (!strcmp(arg, "--dump"))
+        {
+            options.dumpPrefix = value;
+            ++i;
+        }
+        else if (!strcmp(arg, "--dump-interval"))
+        {
+            options.dumpInterval = atoi(value);
+            ++i;
+        }
+        else if (!strcmp(arg, "--log-level"))
+        {
+            LogLevel level;
+            if (!ParseLogLevel(value, level))
+            {
+                cout << "unknown log level " << value << endl;
+                return 1;
+            }
+
+            SetLogLevel(level);
+            ++i;
+        }
+        else
+        {
+            cout << "unknown option " << arg << endl;
+            return 1;
+        }
+    }
+
+    if (benchmark)
+        return RunWithoutWindow([=]{ return RunBenchmark(benchmark); });
+
+    if (replayPath)
+    {
+        return RunWithoutWindow([=]
+        {
+            return RunReplay(replayPath, metricsPath);
+        });
+    }
+
+    if (simulationTicks)
+    {
+        SimulationOptions simulation;
+        simulation.displaySize = options.displaySize;
+        simulation.tickCount = simulationTicks;
+        simulation.seed = options.seed;
+        simulation.isPreparingRender = isPreparingRender;
+        simulation.metricsPath = metricsPath;
+        return RunWithoutWindow([&]{ return RunSimulation(simulation); });
+    }
+
+    if (isHeadless)
+        return RunWithoutWindow([&]{ return RunHeadless(options); });
+
+    auto seed = hasSeed ? options.seed : uint32_t(time(nullptr));
+    RunWindow(
+        isRenderThreaded,
+        isPrecisePacing,
+        frameRateCap,
+        seed,
+        recordPath,
+        metricsPath);
     return 0;
 }
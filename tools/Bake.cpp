@@ -0,0 +1,114 @@
+#include "../AssetBundle.hpp"
+#include "../TextureAtlas.hpp"
+#include "../Debug.hpp"
+#include <SDL_image.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+using namespace std;
+
+/// Bakes the loose assets into one bundle that the game can map straight
+/// into memory: shader sources, and the tile atlas with its mip chain
+/// already converted to ABGR8888. The hash of every source is recorded
+/// so the game can tell when the bundle is out of date.
+
+static const char* const ShaderPaths[] = {
+    "vertex.shader",
+    "fragment.shader",
+    "es2.vertex.shader",
+    "es2.fragment.shader"};
+
+static bool AddFile(AssetBundleWriter& writer, const char* path)
+{
+    ifstream stream(path, ifstream::binary);
+    if (!stream)
+    {
+        LOG_ERROR << "Failed to open " << path << '\n';
+        return false;
+    }
+
+    ostringstream oss;
+    oss << stream.rdbuf();
+    auto text = oss.str();
+
+    // Keep the terminator so the mapped source can go to GL as is.
+    writer.Add(path, text.c_str(), text.size() + 1);
+    return writer.AddSourceHash(path);
+}
+
+static bool AddAtlas(AssetBundleWriter& writer, const char* path)
+{
+    auto sheet = LoadImage(path);
+    if (sheet.pixels.empty()) return false;
+
+    auto atlas = PackAtlas(
+        SliceSheet(sheet, TileSheetCellSize),
+        TileAtlasGutter,
+        TileSheetAnimations);
+
+    BundleAtlasInfo info;
+    info.levelCount = int32_t(atlas.mipLevels.size());
+    info.maxCleanLevel = atlas.maxCleanLevel;
+    writer.Add("atlas.info", &info, sizeof(info));
+    writer.Add(
+        "atlas.regions",
+        atlas.regions.data(),
+        atlas.regions.size() * sizeof(AtlasRegion));
+    writer.Add("atlas.opaque", atlas.opaque.data(), atlas.opaque.size());
+    writer.Add(
+        "atlas.animation",
+        atlas.animation.data(),
+        atlas.animation.size());
+    writer.Add(
+        "atlas.animations",
+        atlas.animations.data(),
+        atlas.animations.size() * sizeof(AtlasAnimation));
+
+    for (int i = 0; i < info.levelCount; ++i)
+    {
+        const auto& level = atlas.mipLevels[i];
+        BundleImageHeader header = {level.width, level.height};
+        auto pixelSize = level.pixels.size() * sizeof(uint32_t);
+
+        vector<uint8_t> blob(sizeof(header) + pixelSize);
+        memcpy(blob.data(), &header, sizeof(header));
+        memcpy(blob.data() + sizeof(header), level.pixels.data(), pixelSize);
+
+        auto name = "atlas.level." + to_string(i);
+        writer.Add(name.c_str(), blob.data(), blob.size());
+    }
+
+    LOG_INFO << "Packed " << path << " into " << info.levelCount
+        << " mip levels\n";
+    return writer.AddSourceHash(path);
+}
+
+int main(int argc, char** argv)
+{
+    AddLogStream(cout);
+    auto output = argc > 1 ? argv[1] : BundlePath;
+
+    SDL_Init(0);
+    IMG_Init(IMG_INIT_PNG);
+
+    AssetBundleWriter writer;
+    bool success = AddAtlas(writer, "images/sheet.png");
+
+    for (auto path : ShaderPaths)
+        success = AddFile(writer, path) && success;
+
+    success = success && writer.Save(output);
+
+    if (success)
+        LOG_INFO << "Wrote " << output << '\n';
+    else
+        LOG_ERROR << "Failed to bake " << output << '\n';
+
+    IMG_Quit();
+    SDL_Quit();
+
+    FlushLog();
+    RemoveAllLogStreams();
+    return success ? 0 : 1;
+}
@@ -1,16 +1,22 @@
 #version 120
 
 uniform mat4 theMatrix;
+uniform float theTime;
+uniform vec3 theAnimations[16]; // Frame count, frames per second, s step.
 attribute vec3 position;
 attribute vec3 color;
 attribute vec2 textureCoordinates;
+attribute float animation;
 varying vec3 _color;
 varying vec2 _textureCoordinates;
 
 void main()
 {
+    vec3 a = theAnimations[int(animation)];
+    float frame = floor(mod(theTime * a.y, a.x));
+
     _color = color;
-    _textureCoordinates = textureCoordinates;
+    _textureCoordinates = textureCoordinates + vec2(frame * a.z, 0.0);
     gl_Position = theMatrix * vec4(position, 1.0);
 }
 